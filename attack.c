@@ -18,10 +18,12 @@
  * of taking city.  If successful, give city to attacker.  Otherwise
  * kill attacking piece.  Tell user who won.
  *
- * If attacking object is not a city, loop.  On each iteration, select one
- * piece to throw a blow.  Damage the opponent by the strength of the blow
- * thrower.  Stop looping when one object has 0 or fewer hits.  Kill off
- * the dead object.  Tell user who won and how many hits her piece has left,
+ * If attacking object is not a city, the pieces fight.  Each blow is
+ * thrown by one piece or the other with equal chance, and damages the
+ * opponent by the strength of the blow thrower, until one object has 0
+ * or fewer hits.  Rather than throw the blows one at a time, we look up
+ * the chance of each way the fight can end and pick one.  Kill off the
+ * dead object.  Tell user who won and how many hits her piece has left,
  * if any.
  */
 
@@ -30,11 +32,138 @@
 #include "extern.h"
 
 void	attack (piece_info_t *, long);
+long	attack_odds (piece_type_t, int, piece_type_t, int);
 static void	attack_city (piece_info_t *, long);
 static void	attack_obj (piece_info_t *, long);
 static void	describe (piece_info_t *, piece_info_t *, long);
+static const int	*fight_odds (piece_type_t, int, piece_type_t, int);
+long	invade_odds (int, int);
 static void	survive (piece_info_t *, long);
 
+/*
+ * The ways a fight can end.  Outcome h-1 is that the attacker wins
+ * with h hits left; outcome MAX_HITS+h-1 is that the defender wins
+ * with h hits left.  For each strength of attacker and defender and
+ * each number of hits they start with, odds_tab gives the chance of
+ * each outcome or any outcome before it, out of ODDS_ONE.
+ *
+ * A fight has fewer than 2*MAX_HITS blows, each with a chance of one
+ * half, so the chances are exact if ODDS_ONE is at least 2 to that
+ * power.
+ */
+
+#define MAX_HITS 10		/* most hits a piece can have */
+#define MAX_STRENGTH 3		/* greatest strength of a piece */
+#define NUM_OUTCOMES (2*MAX_HITS)
+
+static int odds_tab[MAX_STRENGTH+1][MAX_STRENGTH+1][MAX_HITS+1][MAX_HITS+1][NUM_OUTCOMES];
+static char odds_done[MAX_STRENGTH+1][MAX_STRENGTH+1];
+
+#define ATT_WINS(hits) ((hits)-1)
+#define DEF_WINS(hits) (MAX_HITS+(hits)-1)
+
+/*
+ * Return the chances of the ways a fight can end between an attacker
+ * and defender, working them out for the pieces' strengths if we have
+ * not done so before.  Each entry is found from the entries for the
+ * fights that follow the first blow.
+ */
+
+static const int *
+fight_odds (piece_type_t att_type, int att_hits, piece_type_t def_type, int def_hits)
+{
+	int att_str, def_str;
+	int a, d, i;
+	int after_att[NUM_OUTCOMES]; /* chances after attacker is hit */
+	int after_def[NUM_OUTCOMES]; /* chances after defender is hit */
+
+	att_str = piece_attr[att_type].strength;
+	def_str = piece_attr[def_type].strength;
+
+	assert (att_str > 0 && att_str <= MAX_STRENGTH);
+	assert (def_str > 0 && def_str <= MAX_STRENGTH);
+	assert (att_hits > 0 && att_hits <= MAX_HITS);
+	assert (def_hits > 0 && def_hits <= MAX_HITS);
+
+	if (!odds_done[att_str][def_str]) {
+		for (a = 1; a <= MAX_HITS; a++)
+		for (d = 1; d <= MAX_HITS; d++) {
+			for (i = 0; i < NUM_OUTCOMES; i++) {
+				if (a - def_str > 0)
+					after_att[i] = odds_tab[att_str][def_str][a-def_str][d][i];
+				else after_att[i] = i < DEF_WINS (d) ? 0 : ODDS_ONE;
+
+				if (d - att_str > 0)
+					after_def[i] = odds_tab[att_str][def_str][a][d-att_str][i];
+				else after_def[i] = i < ATT_WINS (a) ? 0 : ODDS_ONE;
+
+				assert (((after_att[i] + after_def[i]) & 1) == 0);
+				odds_tab[att_str][def_str][a][d][i] = (after_att[i] + after_def[i]) / 2;
+			}
+		}
+		odds_done[att_str][def_str] = TRUE;
+	}
+	return odds_tab[att_str][def_str][att_hits][def_hits];
+}
+
+/*
+ * Return the chance, out of ODDS_ONE, that a piece of one type with
+ * the given hits will win a fight it starts with a piece of another
+ * type.
+ */
+
+long
+attack_odds (piece_type_t att_type, int att_hits, piece_type_t def_type, int def_hits)
+{
+	return fight_odds (att_type, att_hits, def_type, def_hits)[ATT_WINS (MAX_HITS)];
+}
+
+/*
+ * Return the chance, out of ODDS_ONE, that a number of armies landing
+ * next to a city will take it, if the city is guarded by a number of
+ * enemy armies.  We assume the armies attack one at a time, that each
+ * guard must be beaten before the city is attacked, and that an army
+ * which beats a guard goes on to fight again.  Each attack on the city
+ * uses up the army making it, and succeeds half the time.
+ *
+ * The chance for a armies and g guards is found from the chances for
+ * a armies and g-1 guards, and for a-1 armies and g guards.
+ */
+
+#define MAX_INVADERS 16		/* most armies we work out chances for */
+#define MAX_GUARDS 8		/* most guards we work out chances for */
+
+static long invade_tab[MAX_INVADERS+1][MAX_GUARDS+1];
+static int invade_done;
+
+long
+invade_odds (int armies, int guards)
+{
+	int a, g;
+	long win; /* chance an army beats a guard */
+
+	if (!invade_done) {
+		win = attack_odds (ARMY, piece_attr[ARMY].max_hits,
+				   ARMY, piece_attr[ARMY].max_hits);
+		invade_tab[0][0] = 0;
+		for (a = 1; a <= MAX_INVADERS; a++) /* unguarded city */
+			invade_tab[a][0] = ODDS_ONE / 2
+				+ invade_tab[a-1][0] / 2;
+		for (g = 1; g <= MAX_GUARDS; g++) {
+			invade_tab[0][g] = 0;
+			for (a = 1; a <= MAX_INVADERS; a++)
+				invade_tab[a][g] = ((long long)win * invade_tab[a][g-1]
+					+ (long long)(ODDS_ONE - win) * invade_tab[a-1][g])
+					/ ODDS_ONE;
+		}
+		invade_done = TRUE;
+	}
+	assert (armies >= 0 && guards >= 0);
+	if (armies > MAX_INVADERS) armies = MAX_INVADERS;
+	if (guards > MAX_GUARDS) guards = MAX_GUARDS;
+	return invade_tab[armies][guards];
+}
+
 void
 attack (piece_info_t *att_obj, long loc)
 {
@@ -69,6 +198,7 @@ attack_city (piece_info_t *att_obj, long loc)
 		/* attack succeeded */
 		kill_city(cityp);
 		cityp->owner = att_owner;
+		city_changed();
 		kill_obj(att_obj, loc);
 
 		if (att_owner == USER)
@@ -95,6 +225,9 @@ attack_obj (piece_info_t *att_obj, long loc)
 {
 	piece_info_t *def_obj; /* defender */
 	int owner;
+	const int *odds;
+	long chance;
+	int i;
 
 	def_obj = find_obj_at_loc(loc);
 	assert(def_obj != NULL); /* can't find object to attack? */
@@ -102,12 +235,17 @@ attack_obj (piece_info_t *att_obj, long loc)
 	if (def_obj->type == SATELLITE)
 		return; /* can't attack a satellite */
 
-	while (att_obj->hits > 0 && def_obj->hits > 0)
-	{
-		if (rand_long (2) == 0) /* defender hits? */
-		     att_obj->hits -= piece_attr[def_obj->type].strength;
-		else
-			def_obj->hits -= piece_attr[att_obj->type].strength;
+	odds = fight_odds (att_obj->type, att_obj->hits, def_obj->type, def_obj->hits);
+	chance = rand_long (ODDS_ONE);
+	for (i = 0; chance >= odds[i]; i++);
+
+	if (i < DEF_WINS (1)) { /* attacker wins? */
+		att_obj->hits = i + 1;
+		def_obj->hits = 0;
+	}
+	else {
+		att_obj->hits = 0;
+		def_obj->hits = i - DEF_WINS (1) + 1;
 	}
 
 	if (att_obj->hits > 0)
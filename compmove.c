@@ -24,6 +24,37 @@
 
 static view_map_t emap[MAP_SIZE]; /* pruned explore map */
 
+/*
+ * The predictions vmap_prune_explore_locs makes depend only on which
+ * cells of comp_map are unexplored, and that changes only when we see
+ * something new.  So we remember the predictions and run the pruning
+ * again only when the unexplored cells differ from last time.
+ */
+
+static unsigned char predict[MAP_SIZE];	/* emap contents of unexplored cells, 0 if explored */
+static int predict_valid;		/* TRUE if predict matches map */
+
+/*
+ * Pieces look for objectives on maps derived from comp_map.  Rather
+ * than copy comp_map for every piece, we keep two copies up to date:
+ * load_map is a copy of comp_map, and explore_map is a copy in which
+ * the pruned explore locs are unmarked.  comp_map_changed logs each
+ * cell of comp_map which changes, and a map is brought up to date
+ * just before it is used.  A piece then marks the cells it cares about
+ * on the map, and clear_marks puts them back after the search.
+ */
+
+static view_map_t load_map[MAP_SIZE];	/* comp_map plus marks */
+static view_map_t explore_map[MAP_SIZE]; /* comp_map less explore locs, plus marks */
+static int load_synced;			/* change_log entries applied to load_map, -1 if none */
+static int explore_synced;		/* change_log entries applied to explore_map */
+static long change_log[MAP_SIZE];	/* cells changed in comp_map */
+static int change_len;			/* entries in change_log */
+static long mark_list[MAP_SIZE];	/* cells marked on a map */
+static int mark_len;			/* entries in mark_list */
+
+void	comp_map_changed (long);
+void	comp_map_reloaded (void);
 void	comp_move (void);
 static void	army_move (piece_info_t *);
 static void	board_ship (piece_info_t *, path_map_t *, long);
@@ -35,13 +66,17 @@ static void	cpiece_move (piece_info_t *);
 static void	do_cities (void);
 static void	do_pieces (void);
 static void	fighter_move (piece_info_t *);
-static long	find_attack (long, const char *, const char *);
+static long	find_attack (piece_info_t *, const char *, const char *);
 static piece_info_t	*find_best_tt (piece_info_t *, long);
 static int	lake (long);
 static int	load_army (piece_info_t *);
-static void	make_army_load_map (piece_info_t *, view_map_t *, view_map_t *);
-static void    make_tt_load_map (view_map_t *, view_map_t *);
-static void    make_unload_map (view_map_t *, view_map_t *);
+static void	make_emap (void);
+static void	clear_marks (view_map_t *);
+static view_map_t	*make_army_load_map (piece_info_t *);
+static view_map_t	*make_explore_map (void);
+static view_map_t	*make_tt_load_map (void);
+static view_map_t	*make_unload_map (int);
+static void	mark_cell (view_map_t *, long, char);
 static void    move1 (piece_info_t *);
 static long    move_away (view_map_t *, long, const char *);
 static void    move_objective (piece_info_t *, path_map_t[], long, const char *);
@@ -49,27 +84,27 @@ static int     nearby_count (long);
 static int     nearby_load (piece_info_t *, long);
 static int     need_more (int *, int, int);
 static int	overproduced (city_info_t *, int *);
+static void	repair (piece_info_t *);
 static void    ship_move (piece_info_t *);
 static void    transport_move (piece_info_t *);
-static void	unmark_explore_locs (view_map_t *);
+static void	set_cell (view_map_t *, long);
+static void	sync_map (view_map_t *, int *);
+static int	unload_class (const view_map_t *, long);
+static piece_type_t	user_piece_type (char);
 
 void
 comp_move (void) 
 {
-	piece_type_t j;
-	const piece_info_t *obj;
-
 	/* Update our view of the world. */
 	
-	for (j = FIRST_OBJECT; j < NUM_OBJECTS; j++)
-		for (obj = comp_obj[j]; obj != NULL; obj = obj->piece_link.next)
-			scan(comp_map, obj->loc); /* refresh comp's view of world */
+	scan_side (COMP); /* refresh comp's view of world */
 
 	/* for each move we get... */
 	prompt("Thinking...");
 
-	memcpy(emap, comp_map, MAP_SIZE * sizeof (view_map_t));
-	vmap_prune_explore_locs(emap);
+	make_emap ();
+	load_synced = explore_synced = -1; /* copy all of comp_map when used */
+	change_len = 0;
 	
 	do_cities(); /* handle city production */
 	do_pieces(); /* move pieces */
@@ -102,12 +137,9 @@ do_cities (void)
 	int is_lake;
 
 	for (i = 0; i < NUM_CITY; i++) /* new production */
-	if (city[i].owner == COMP) {
-		scan (comp_map, city[i].loc);
+	if (city[i].owner == COMP && city[i].prod == NOPIECE)
+		comp_prod (&city[i], lake (city[i].loc));
 
-		if (city[i].prod == NOPIECE)
-			comp_prod (&city[i], lake (city[i].loc));
-	}
 	for (i = 0; i < NUM_CITY; i++) /* produce and change */
 	if (city[i].owner == COMP) {
 		is_lake = lake (city[i].loc);
@@ -152,7 +184,7 @@ static void
 comp_prod (city_info_t *cityp, int is_lake)
 {
 	int city_count[NUM_OBJECTS]; /* # of cities producing each piece */
-	int cont_map[MAP_SIZE];
+	int *cont_map;
 	int total_cities;
 	long i;
 	piece_type_t j;
@@ -164,6 +196,7 @@ comp_prod (city_info_t *cityp, int is_lake)
 	/* Make sure we have army producers for current continent. */
 	
 	/* map out city's continent */
+	cont_map = cmap_get ();
 	vmap_cont (cont_map, comp_map, cityp->loc, '.');
 
 	/* count items of interest on the continent */
@@ -178,6 +211,7 @@ comp_prod (city_info_t *cityp, int is_lake)
 			if (p->prod == ARMY) comp_ac += 1;
 		}
 	}
+	cmap_put (cont_map);
 	/* see if anything of interest is on continent */
 	interest = (counts.unexplored || counts.user_cities
 		 || counts.user_objects[ARMY]
@@ -369,32 +403,70 @@ comp_set_needed (city_info_t *cityp, int *city_count, int army_ok, int is_lake)
 static int
 lake (long loc)
 {
-	int cont_map[MAP_SIZE];
+	int *cont_map;
 	scan_counts_t counts;
 
+	cont_map = cmap_get ();
 	vmap_cont (cont_map, emap, loc, '+'); /* map lake */
 	counts = vmap_cont_scan (cont_map, emap);
+	cmap_put (cont_map);
 
 	return !(counts.unowned_cities || counts.user_cities || counts.unexplored);
 }
 
-/* Move all computer pieces. */
+/*
+ * Move all computer pieces.
+ *
+ * If the computer's turn has a time limit, the pieces we get to after
+ * the time is up wait where they are, except for fighters, which must
+ * still get home, and satellites, which cost nothing to move.  Boats
+ * which wait in port are still repaired.  So that the same pieces
+ * don't wait every turn, we first move the pieces of every type that
+ * waited last turn, and only then the rest.  A piece that waits is
+ * thus moved next turn ahead of every piece that didn't, and waits
+ * again only if the pieces that waited with it use up the whole turn.
+ */
 
-static view_map_t amap[MAP_SIZE]; /* temp view map */
 static path_map_t path_map[MAP_SIZE];
 
+static long wait_date[LIST_SIZE]; /* 1 + date each piece last waited */
+
 static void
 do_pieces (void)
 {
 	/* move pieces */
-	piece_type_t i;
+	piece_type_t i, type;
 	piece_info_t *obj, *next_obj;
+	long deadline;
+	long *waited;
+	int waiting;
+	int pass;
 
+	deadline = clock_ms () + comp_budget;
+	waiting = FALSE;
+
+	for (pass = 0; pass < 2; pass++) /* waiting pieces, then the rest */
 	for (i = 0; i < NUM_OBJECTS; i++) { /* loop through obj lists */
-		for (obj = comp_obj[move_order[i]]; obj != NULL;
+		type = move_order[i];
+		for (obj = comp_obj[type]; obj != NULL;
 		    obj = next_obj) { /* loop through objs in list */
 			next_obj = obj->piece_link.next;
-			cpiece_move (obj); /* yup; move the object */
+			waited = &wait_date[obj - object];
+
+			if (pass == 0 && *waited != date)
+				continue; /* didn't wait last turn */
+			if (pass == 1 && *waited >= date)
+				continue; /* already seen this turn */
+
+			if (type != FIGHTER && type != SATELLITE && !waiting
+			    && comp_budget > 0 && clock_ms () >= deadline)
+				waiting = TRUE; /* no time left */
+
+			if (waiting && type != FIGHTER && type != SATELLITE) {
+				*waited = date + 1; /* move it first next turn */
+				repair (obj); /* piece stays where it is */
+			}
+			else cpiece_move (obj); /* yup; move the object */
 		}
 	}
 }
@@ -409,7 +481,6 @@ static void
 cpiece_move (piece_info_t *obj)
 {
 	int changed_loc;
-	int max_hits;
 	long saved_loc;
 	city_info_t *cityp;
 
@@ -420,7 +491,6 @@ cpiece_move (piece_info_t *obj)
 	
 	obj->moved = 0; /* not moved yet */
 	changed_loc = FALSE; /* not changed yet */
-	max_hits = piece_attr[obj->type].max_hits;
 
 	if (obj->type == FIGHTER) { /* init fighter range */
 		cityp = find_city (obj->loc);
@@ -444,11 +514,20 @@ cpiece_move (piece_info_t *obj)
 			}
 		}
 	}
-	/* if a boat is in port, damaged, and never moved, fix some damage */
+	if (!changed_loc) /* object never changed location? */
+		repair (obj);
+
+	display_flush (); /* show the completed move */
+}
+
+/* If a boat which hasn't moved is in port and damaged, fix some damage. */
+
+static void
+repair (piece_info_t *obj)
+{
 	if (obj->hits > 0 /* live piece? */
-		&& !changed_loc /* object never changed location? */
 		&& obj->type != ARMY && obj->type != FIGHTER /* it is a boat? */
-		&& obj->hits != max_hits /* it is damaged? */
+		&& obj->hits != piece_attr[obj->type].max_hits /* it is damaged? */
 		&& comp_map[obj->loc].contents == 'X') /* it is in port? */
 	obj->hits++; /* fix some damage */
 }
@@ -499,9 +578,10 @@ static void
 army_move (piece_info_t *obj)
 {
 	long new_loc;
-	path_map_t path_map2[MAP_SIZE];
+	path_map_t *path_map2;
 	long new_loc2;
 	int cross_cost; /* cost to enter water */
+	view_map_t *xmap;
 	
 	obj->func = 0; /* army doesn't want a tt */
 	if (vmap_at_sea (comp_map, obj->loc)) { /* army can't move? */
@@ -511,8 +591,8 @@ army_move (piece_info_t *obj)
 		return;
 	}
 	if (obj->ship) /* is army on a transport? */
-		new_loc = find_attack (obj->loc, army_attack, "+*");
-	else new_loc = find_attack (obj->loc, army_attack, ".+*");
+		new_loc = find_attack (obj, army_attack, "+*");
+	else new_loc = find_attack (obj, army_attack, ".+*");
 		
 	if (new_loc != obj->loc) { /* something to attack? */
 		attack (obj, new_loc); /* attack it */
@@ -531,8 +611,9 @@ army_move (piece_info_t *obj)
 				panic("couldn't load army");
 			return; /* armies stay on a loading ship */
 		}
-		make_unload_map (amap, comp_map);
-		new_loc = vmap_find_wlobj (path_map, amap, obj->loc, &tt_unload);
+		xmap = make_unload_map (obj->ship->count);
+		new_loc = vmap_find_wlobj (path_map, xmap, obj->loc, &tt_unload);
+		clear_marks (xmap);
 		move_objective (obj, path_map, new_loc, " ");
 		return;
 	}
@@ -564,28 +645,132 @@ army_move (piece_info_t *obj)
 	
 	if (new_loc == obj->loc || cross_cost > 0) {
 		/* see if there is something interesting to load */
-		make_army_load_map (obj, amap, comp_map);
-		new_loc2 = vmap_find_lwobj (path_map2, amap, obj->loc, &army_load, cross_cost);
+		xmap = make_army_load_map (obj);
+		path_map2 = pmap_get ();
+		new_loc2 = vmap_find_lwobj (path_map2, xmap, obj->loc, &army_load, cross_cost);
+		clear_marks (xmap);
 		
 		if (new_loc2 != obj->loc) { /* found something? */
 			board_ship (obj, path_map2, new_loc2);
+			pmap_put (path_map2);
 			return;
 		}
+		pmap_put (path_map2);
 	}
 
 	move_objective (obj, path_map, new_loc, " ");
 }
 
-/* Remove pruned explore locs from a view map. */
+/*
+ * Make the pruned explore map, reusing the last predictions if no
+ * unexplored cell has been seen since they were made.
+ */
 
 static void
-unmark_explore_locs (view_map_t *xmap)
+make_emap (void)
 {
 	long i;
 
+	if (predict_valid)
 	for (i = 0; i < MAP_SIZE; i++)
-	if (map[i].on_board && xmap[i].contents == ' ')
-		xmap[i].contents = emap[i].contents;
+	if ((comp_map[i].contents == ' ') != (predict[i] != 0)) {
+		predict_valid = FALSE;
+		break;
+	}
+	if (!predict_valid) {
+		memcpy(emap, comp_map, MAP_SIZE * sizeof (view_map_t));
+		vmap_prune_explore_locs(emap);
+
+		for (i = 0; i < MAP_SIZE; i++)
+			predict[i] = comp_map[i].contents == ' ' ? emap[i].contents : 0;
+		predict_valid = TRUE;
+		return;
+	}
+	for (i = 0; i < MAP_SIZE; i++)
+		emap[i].contents = predict[i] ? predict[i] : comp_map[i].contents;
+}
+
+/*
+ * Note that comp_map and the real map have been replaced, so our
+ * predictions are no longer good.
+ */
+
+void
+comp_map_reloaded (void)
+{
+	predict_valid = FALSE;
+}
+
+/* Note that a cell of comp_map has changed. */
+
+void
+comp_map_changed (long loc)
+{
+	if (change_len == MAP_SIZE) { /* log is full; copy everything */
+		load_synced = explore_synced = -1;
+		change_len = 0;
+	}
+	change_log[change_len++] = loc;
+}
+
+/* Copy a cell of comp_map to a derived map. */
+
+static void
+set_cell (view_map_t *xmap, long loc)
+{
+	xmap[loc] = comp_map[loc];
+	if (xmap == explore_map && map[loc].on_board && xmap[loc].contents == ' ')
+		xmap[loc].contents = emap[loc].contents; /* unmark pruned explore loc */
+}
+
+/* Bring a derived map up to date with comp_map. */
+
+static void
+sync_map (view_map_t *xmap, int *synced)
+{
+	long i;
+
+	if (*synced < 0) {
+		for (i = 0; i < MAP_SIZE; i++)
+			set_cell (xmap, i);
+	}
+	else for (i = *synced; i < change_len; i++)
+		set_cell (xmap, change_log[i]);
+	*synced = change_len;
+
+	if (load_synced == change_len && explore_synced == change_len)
+		load_synced = explore_synced = change_len = 0; /* all applied */
+}
+
+/* Mark a cell on a derived map. */
+
+static void
+mark_cell (view_map_t *xmap, long loc, char contents)
+{
+	assert (mark_len < MAP_SIZE);
+	mark_list[mark_len++] = loc;
+	xmap[loc].contents = contents;
+}
+
+/* Remove the marks from a derived map. */
+
+static void
+clear_marks (view_map_t *xmap)
+{
+	int i;
+
+	for (i = 0; i < mark_len; i++)
+		set_cell (xmap, mark_list[i]);
+	mark_len = 0;
+}
+
+/* Return comp_map with pruned explore locs unmarked. */
+
+static view_map_t *
+make_explore_map (void)
+{
+	sync_map (explore_map, &explore_synced);
+	return (explore_map);
 }
 
 /*
@@ -593,77 +778,98 @@ unmark_explore_locs (view_map_t *xmap)
  * transport and tt producing city with a '$'.
  */
 
-static void
-make_army_load_map (piece_info_t *obj, view_map_t *xmap, view_map_t *vmap)
+static view_map_t *
+make_army_load_map (piece_info_t *obj)
 {
 	piece_info_t *p;
 	int i;
 	
-	memcpy (xmap, vmap, sizeof (view_map_t) * MAP_SIZE);
+	sync_map (load_map, &load_synced);
 
 	/* mark loading transports or cities building transports */
 	for (p = comp_obj[TRANSPORT]; p; p = p->piece_link.next)
 	if (p->func == 0) /* loading tt? */
-	xmap[p->loc].contents = '$';
+	mark_cell (load_map, p->loc, '$');
 	
 	for (i = 0; i < NUM_CITY; i++)
 	if (city[i].owner == COMP && city[i].prod == TRANSPORT) {
 		if (nearby_load (obj, city[i].loc))
-			xmap[city[i].loc].contents = 'x'; /* army is nearby so it can load */
+			mark_cell (load_map, city[i].loc, 'x'); /* army is nearby so it can load */
 		else if (nearby_count (city[i].loc) < piece_attr[TRANSPORT].capacity)
-			xmap[city[i].loc].contents = 'x'; /* city needs armies */
+			mark_cell (load_map, city[i].loc, 'x'); /* city needs armies */
 	}
 	
 	if (print_vmap == 'A')
-		print_zoom(xmap);
+		print_zoom(load_map);
+	return (load_map);
 }
 
 /* Return true if an army is considered near a location for loading. */
 
+#define NEARBY_DIST 2 /* how near an army must be */
+
 static int
 nearby_load (piece_info_t *obj, long loc)
 {
-	return obj->func == 1 && dist (obj->loc, loc) <= 2;
+	return obj->func == 1 && dist (obj->loc, loc) <= NEARBY_DIST;
 }
 	
-/* Return number of nearby armies. */
+/*
+ * Return number of nearby armies.  Only armies within two rows and
+ * columns of the location can be near it, so rather than walk every
+ * army we look at the pieces in each of those cells.
+ */
 
 static int
 nearby_count (long loc)
 {
 	piece_info_t *obj;
+	long r, c, r0, r1, c0, c1, i;
 	int count;
 
+	r0 = loc_row (loc) - NEARBY_DIST;
+	r1 = loc_row (loc) + NEARBY_DIST;
+	c0 = loc_col (loc) - NEARBY_DIST;
+	c1 = loc_col (loc) + NEARBY_DIST;
+	if (r0 < 0) r0 = 0;
+	if (r1 > MAP_HEIGHT-1) r1 = MAP_HEIGHT-1;
+	if (c0 < 0) c0 = 0;
+	if (c1 > MAP_WIDTH-1) c1 = MAP_WIDTH-1;
+
 	count = 0;
-	for (obj = comp_obj[ARMY]; obj; obj = obj->piece_link.next) {
-		if (nearby_load (obj, loc)) count += 1;
+	for (r = r0; r <= r1; r++)
+	for (c = c0; c <= c1; c++) {
+		i = row_col_loc (r, c);
+		for (obj = map[i].objp; obj; obj = obj->loc_link.next)
+		if (obj->owner == COMP && obj->type == ARMY
+		    && nearby_load (obj, loc)) count += 1;
 	}
 	return count;
 }
 
 /* Make load map for a ship. */
 
-static void
-make_tt_load_map (view_map_t *xmap, view_map_t *vmap)
+static view_map_t *
+make_tt_load_map (void)
 {
 	piece_info_t *p;
 	
-	memcpy (xmap, vmap, sizeof (view_map_t) * MAP_SIZE);
+	sync_map (load_map, &load_synced);
 
 	/* mark loading armies */
 	for (p = comp_obj[ARMY]; p; p = p->piece_link.next)
 	if (p->func == 1) /* loading army? */
-	xmap[p->loc].contents = '$';
+	mark_cell (load_map, p->loc, '$');
 	
 	if (print_vmap == 'L')
-		print_zoom(xmap);
+		print_zoom(load_map);
+	return (load_map);
 }
 	
 /*
- * Make an unload map.  We copy the view map.  We then create
- * a continent map.  For each of our cities, we mark out the continent
- * that city is on.  Then, for each city that we don't own and which
- * doesn't appear on our continent map, we set that square to a digit.
+ * Make an unload map.  We copy the view map, unmarking pruned explore
+ * locs.  Then, for each city that we don't own, we set that square to
+ * a digit.
  * 
  * We want to assign weights to each attackable city.
  * Cities are more valuable if they are on a continent which
@@ -684,54 +890,119 @@ make_tt_load_map (view_map_t *xmap, view_map_t *vmap)
  *       getting a two city continent ))
  *       
  * d)  Any other attackable city is marked with a '0'.
+ *
+ * e)  A city is also marked with a '0' if the armies we have to land
+ *     stand little chance of taking it from the enemy armies we can see
+ *     next to it.
+ *
+ * Every attackable city on a continent sees the same continent, so
+ * rather than map out the continent of each city in turn, we find all
+ * of the continents in one pass and count their cities.  We then mark
+ * the cities in map order.  A marked city is counted by its real owner
+ * rather than by how it appears on the map, so after marking a city we
+ * adjust the counts for the rest of its continent to match.
  */
 
-static int owncont_map[MAP_SIZE];
-static int tcont_map[MAP_SIZE];
+static int ucont[MAP_SIZE];		/* continent of each cell, 0 if none */
+static long ulist[MAP_SIZE];		/* cells being expanded */
+static int ucount[NUM_CITY+1][3];	/* cities of each owner, by continent */
 
-static void
-make_unload_map (view_map_t *xmap, view_map_t *vmap)
+#define MIN_INVADE_ODDS (ODDS_ONE / 4)
+
+static view_map_t *
+make_unload_map (int armies)
 {
-	long i;
-	scan_counts_t counts;
+	long i, loc, new_loc;
+	int j, k, n, len, total_cities, owner, guards;
+	int *counts;
 
-	memcpy (xmap, vmap, sizeof (view_map_t) * MAP_SIZE);
-	unmark_explore_locs (xmap);
-	
-	for (i = 0; i < MAP_SIZE; i++)
-		owncont_map[i] = 0; /* nothing marked */
+	sync_map (explore_map, &explore_synced);
+	memset (ucont, 0, sizeof (ucont));
+	n = 0;
 
-	for (i = 0; i < NUM_CITY; i++)
-	if (city[i].owner == COMP)
-	vmap_mark_up_cont (owncont_map, xmap, city[i].loc, '.');
+	for (i = 0; i < MAP_SIZE; i++)
+	if ((comp_map[i].contents == 'O' || comp_map[i].contents == '*') && ucont[i] == 0) {
+		n++; /* a new continent */
+		ucount[n][USER] = ucount[n][COMP] = ucount[n][UNOWNED] = 0;
+		ucont[i] = n;
+		ulist[0] = i;
+		len = 1;
+		while (len > 0) { /* mark up the continent */
+			loc = ulist[--len];
+			owner = unload_class (explore_map, loc);
+			if (owner >= 0) ucount[n][owner]++;
+
+			FOR_ADJ_ON (loc, new_loc, j)
+			if (!ucont[new_loc] && explore_map[new_loc].contents != ' '
+			    && (explore_map[new_loc].contents == '+'
+			    || (explore_map[new_loc].contents != '.'
+			    && map[new_loc].contents != '.'))) {
+				ucont[new_loc] = n;
+				ulist[len++] = new_loc;
+			}
+		}
+	}
 
 	for (i = 0; i < MAP_SIZE; i++)
-	if (strchr ("O*", vmap[i].contents)) {
-		int total_cities;
+	if (comp_map[i].contents == 'O' || comp_map[i].contents == '*') {
+		counts = ucount[ucont[i]];
 		
-		vmap_cont (tcont_map, xmap, i, '.'); /* map continent */
-		counts = vmap_cont_scan (tcont_map, xmap);
-		
-		total_cities = counts.unowned_cities
-			     + counts.user_cities
-			     + counts.comp_cities;
+		total_cities = counts[UNOWNED]
+			     + counts[USER]
+			     + counts[COMP];
 			     
 		if (total_cities > 9) total_cities = 0;
 		
-		if (counts.user_cities && counts.comp_cities)
-			xmap[i].contents = '0' + total_cities;
+		if (counts[USER] && counts[COMP])
+			k = '0' + total_cities;
 
-		else if (counts.unowned_cities > counts.user_cities
-			 && counts.comp_cities == 0)
-			xmap[i].contents = '0' + total_cities;
+		else if (counts[UNOWNED] > counts[USER]
+			 && counts[COMP] == 0)
+			k = '0' + total_cities;
 
-		else if (counts.user_cities == 1 && counts.comp_cities == 0)
-			xmap[i].contents = '2';
+		else if (counts[USER] == 1 && counts[COMP] == 0)
+			k = '2';
 			
-		else xmap[i].contents = '0';
+		else k = '0';
+
+		if (k != '0') { /* worth invading; can we? */
+			guards = 0;
+			FOR_ADJ_ON (i, new_loc, j)
+				if (comp_map[new_loc].contents == 'A') guards++;
+			if (invade_odds (armies, guards) < MIN_INVADE_ODDS)
+				k = '0';
+		}
+
+		counts[unload_class (explore_map, i)]--;
+		mark_cell (explore_map, i, k);
+		counts[unload_class (explore_map, i)]++;
 	}
 	if (print_vmap == 'U')
-		print_zoom(xmap);
+		print_zoom(explore_map);
+	return (explore_map);
+}
+
+/*
+ * Return the owner of the city on a cell for counting as
+ * vmap_cont_scan does, or -1 if there is no city.
+ */
+
+static int
+unload_class (const view_map_t *xmap, long loc)
+{
+	switch (xmap[loc].contents) {
+	case 'O': return (USER);
+	case 'X': return (COMP);
+	case '*': return (UNOWNED);
+	case ' ': case '+': case '.':
+	case 'A': case 'F': case 'P': case 'D': case 'S': case 'T': case 'C': case 'B':
+	case 'a': case 'f': case 'p': case 'd': case 's': case 't': case 'c': case 'b':
+		return (-1);
+	default: /* check for city underneath */
+		if (map[loc].contents == '*')
+			return (map[loc].cityp->owner);
+		return (-1);
+	}
 }
 
 /*
@@ -821,19 +1092,26 @@ move_away (view_map_t *vmap, long loc, const char *terrain)
 
 /*
  * Look to see if there is an adjacent object to attack.  We are passed
- * a location and a list of items we attack sorted in order of most
+ * a piece and a list of items we attack sorted in order of most
  * valuable first.  We look at each surrounding on board location.
  * If there is an object we can attack, we return the location of the
  * best of these.
+ *
+ * We don't attack a piece we have little chance of beating, assuming
+ * it has not been damaged.
  */
 
+#define MIN_ODDS (ODDS_ONE / 8)
+
 static long
-find_attack (long loc, const char *obj_list, const char *terrain)
+find_attack (piece_info_t *obj, const char *obj_list, const char *terrain)
 {
-	long new_loc, best_loc;
+	long loc, new_loc, best_loc;
 	int i, best_val;
 	char *p;
+	piece_type_t def_type;
 
+	loc = obj->loc;
 	best_loc = loc; /* nothing found yet */
 	best_val = INFINITY;
 	for (i = 0; i < 8; i++) {
@@ -842,6 +1120,12 @@ find_attack (long loc, const char *obj_list, const char *terrain)
 		if (map[new_loc].on_board /* can we move here? */
 		    && strchr (terrain, map[new_loc].contents)) {
 			p = strchr (obj_list, comp_map[new_loc].contents);
+			if (p != NULL && map[new_loc].contents != '*') {
+				def_type = user_piece_type (*p);
+				if (attack_odds (obj->type, obj->hits, def_type,
+				    piece_attr[def_type].max_hits) < MIN_ODDS)
+					p = NULL; /* too risky */
+			}
 			if (p != NULL && p - obj_list < best_val) {
 				best_val = p - obj_list;
 				best_loc = new_loc;
@@ -851,6 +1135,20 @@ find_attack (long loc, const char *obj_list, const char *terrain)
 	return (best_loc);
 }
 
+/* Return the type of a user's piece shown on the map as 'c'. */
+
+static piece_type_t
+user_piece_type (char c)
+{
+	piece_type_t i;
+
+	for (i = FIRST_OBJECT; i < NUM_OBJECTS; i++)
+		if (piece_attr[i].sname == c)
+			return i;
+	panic("unrecognized piece");
+	return NOPIECE;
+}
+
 /*
  * Move a transport.
  *
@@ -867,11 +1165,12 @@ static void
 transport_move (piece_info_t *obj)
 {
 	long new_loc;
+	view_map_t *xmap;
 
 	/* empty transports can attack */
 	if (obj->count == 0) { /* empty? */
 		obj->func = 0; /* transport is loading */
-		new_loc = find_attack (obj->loc, tt_attack, ".");
+		new_loc = find_attack (obj, tt_attack, ".");
 		if (new_loc != obj->loc) { /* something to attack? */
 			attack (obj, new_loc); /* attack it */
 			return;
@@ -882,22 +1181,23 @@ transport_move (piece_info_t *obj)
 		obj->func = 1; /* unloading */
 
 	if (obj->func == 0) { /* loading? */
-		make_tt_load_map (amap, comp_map);
-		new_loc = vmap_find_wlobj (path_map, amap, obj->loc, &tt_load);
+		xmap = make_tt_load_map ();
+		new_loc = vmap_find_wlobj (path_map, xmap, obj->loc, &tt_load);
+		clear_marks (xmap);
 		
 		if (new_loc == obj->loc) { /* nothing to load? */
-			memcpy (amap, comp_map, MAP_SIZE * sizeof (view_map_t));
-			unmark_explore_locs (amap);
+			xmap = make_explore_map ();
 			if (print_vmap == 'S')
-				print_zoom(amap);
-			new_loc = vmap_find_wobj (path_map, amap, obj->loc, &tt_explore);
+				print_zoom(xmap);
+			new_loc = vmap_find_wobj (path_map, xmap, obj->loc, &tt_explore);
 		}
 		
 		move_objective (obj, path_map, new_loc, "a ");
 	}
 	else {
-		make_unload_map (amap, comp_map);
-		new_loc = vmap_find_wlobj (path_map, amap, obj->loc, &tt_unload);
+		xmap = make_unload_map (obj->count);
+		new_loc = vmap_find_wlobj (path_map, xmap, obj->loc, &tt_unload);
+		clear_marks (xmap);
 		move_objective (obj, path_map, new_loc, " ");
 	}
 }
@@ -919,7 +1219,7 @@ fighter_move (piece_info_t *obj)
 {
 	long new_loc;
 
-	new_loc = find_attack (obj->loc, fighter_attack, ".+");
+	new_loc = find_attack (obj, fighter_attack, ".+");
 	if (new_loc != obj->loc) { /* something to attack? */
 		attack (obj, new_loc); /* attack it */
 		return;
@@ -951,6 +1251,7 @@ ship_move (piece_info_t *obj)
 {
 	long new_loc;
 	const char *adj_list;
+	view_map_t *xmap;
 
 	if (obj->hits < piece_attr[obj->type].max_hits) { /* head to port */
 		if (comp_map[obj->loc].contents == 'X') { /* stay in port */
@@ -963,18 +1264,17 @@ ship_move (piece_info_t *obj)
 
 	}
 	else {
-		new_loc = find_attack (obj->loc, ship_attack, ".");
+		new_loc = find_attack (obj, ship_attack, ".");
 		if (new_loc != obj->loc) { /* something to attack? */
 			attack (obj, new_loc); /* attack it */
 			return;
 		}
 		/* look for an objective */
-		memcpy (amap, comp_map, MAP_SIZE * sizeof (view_map_t));
-		unmark_explore_locs (amap);
+		xmap = make_explore_map ();
 		if (print_vmap == 'S')
-			print_zoom (amap);
+			print_zoom (xmap);
 		
-		new_loc = vmap_find_wobj (path_map, amap, obj->loc,
+		new_loc = vmap_find_wobj (path_map, xmap, obj->loc,
 					       &ship_fight);
 		adj_list = ship_fight.objectives;
 	}
@@ -1074,7 +1374,7 @@ move_objective (piece_info_t *obj, path_map_t pathmap[], long new_loc, const cha
 			terrain = ".";
 			break;
 		}
-		if (find_attack (obj->loc, attack_list, terrain) != obj->loc)
+		if (find_attack (obj, attack_list, terrain) != obj->loc)
 			return;
 		
 		/* clear old path */
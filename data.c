@@ -247,12 +247,17 @@ int SMOOTH;		/* number of times to smooth map */
 int WATER_RATIO;	/* percentage of map that is water */
 int MIN_CITY_DIST;	/* cities must be at least this far apart */
 int save_interval;	/* turns between autosaves */
+int journal_interval;	/* saves per full checkpoint, 0 = no journal */
 int traditional = 0;	/* use `traditional' UI */
 int color = 1;		/* use color if available */
+int frame_rate = -1;	/* automove screen updates per second, -1 = all */
+int comp_budget = 0;	/* milliseconds for moving computer pieces, 0 = no limit */
 
 real_map_t map[MAP_SIZE];	/* the way the world really looks */
 view_map_t comp_map[MAP_SIZE];	/* computer's view of the world */
 view_map_t user_map[MAP_SIZE];	/* user's view of the world */
+int comp_seen[MAP_SIZE];	/* date each cell of comp_map was updated */
+int user_seen[MAP_SIZE];	/* date each cell of user_map was updated */
 
 city_info_t city[NUM_CITY]; /* city information */
 
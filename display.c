@@ -18,6 +18,7 @@
  * 	point of view;
  */
 
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 #include <strings.h>
@@ -33,6 +34,8 @@
 
 int     cur_sector (void);
 void    display_loc (int, view_map_t[], long);
+void    display_flush (void);
+void    display_hold (int);
 void    display_locx (int, view_map_t[], long);
 void    display_score (void);
 void    help (const char **, int);
@@ -44,11 +47,15 @@ void    print_sector (char, view_map_t[], int);
 void    print_pzoom (char *, const path_map_t *, const view_map_t *);
 void    print_zoom (const view_map_t *);
 void	sector_change (void);
+static void	dirty_clear (void);
 static void	display_screen (view_map_t[]);
+static void	draw_sector (void);
+static int	frame_due (void);
 static void	disp_square(view_map_t[], long);
 static int	on_screen (long);
 static void	print_pzoom_cell (const path_map_t *, const view_map_t *, int, int, int, int);
 static void	print_zoom_cell (const view_map_t *, int, int, int, int);
+static void	rank_zoom_list (void);
 static void	show_loc (view_map_t[], long);
 
 static int whose_map = UNOWNED; /* user's or computer's point of view */
@@ -58,6 +65,30 @@ static int save_sector; /* the currently displayed sector */
 static int save_cursor; /* currently displayed cursor position */
 static int change_ok = TRUE; /* true if new sector may be displayed */
 
+/*
+ * Cells whose display has changed but which have not yet been drawn.
+ * Rather than refreshing the terminal for every cell, we collect the
+ * cells here and draw them all at once in display_flush.
+ */
+
+static unsigned char dirty[MAP_SIZE]; /* TRUE if cell is in dirty_list */
+static long dirty_list[MAP_SIZE];
+static int dirty_count;
+static view_map_t *dirty_vmap; /* map the dirty cells are drawn from */
+
+/*
+ * While the display is held (during automove), flushes are limited to
+ * frame_rate per second, or suppressed entirely if frame_rate is zero.
+ * A sector redraw requested in the meantime is remembered and done at
+ * the next frame.
+ */
+
+static int held; /* TRUE if display updates are rate limited */
+static long last_frame; /* clock_ms() of last screen update */
+static int redraw_pending; /* TRUE if sector must be redrawn */
+static int clear_pending; /* TRUE if map window must be erased first */
+static view_map_t *sector_vmap; /* map the current sector is drawn from */
+
 #define NUMBOTS		1
 #define MAPWIN_HEIGHT	(lines - NUMTOPS - NUMBOTS)
 #define	MAPWIN_WIDTH	(cols - NUMSIDES)
@@ -79,6 +110,8 @@ void
 kill_display (void)
 {
 	whose_map = UNOWNED;
+	redraw_pending = FALSE;
+	dirty_clear ();
 }
 
 /*
@@ -122,6 +155,7 @@ display_loc (int whose, view_map_t vmap[], long loc)
 		print_sector (whose, vmap, loc_sector (loc));
 		
 	show_loc (vmap, loc);
+	display_flush (); /* user should see this location now */
 }
 
 /* Display a location iff the location is on the screen. */
@@ -133,20 +167,106 @@ display_locx (int whose, view_map_t vmap[], long loc)
 		show_loc (vmap, loc);
 }
 
-/* Display a location which exists on the screen. */
+/*
+ * Mark a location which exists on the screen as needing to be
+ * redrawn.  The cell is actually drawn by the next display_flush.
+ */
 
 static void
 show_loc (view_map_t vmap[], long loc)
 {
-	int r, c;
-	
-	r = loc_row (loc);
-	c = loc_col (loc);
-	wmove(mapwin, r-ref_row+1, c-ref_col+1);
-	disp_square(vmap, loc);
+	if (!dirty[loc]) {
+		dirty[loc] = TRUE;
+		dirty_list[dirty_count++] = loc;
+	}
+	dirty_vmap = vmap;
 	save_cursor = loc; /* remember cursor location */
-	wmove(mapwin, r-ref_row+1, c-ref_col+1);
-	wrefresh(mapwin);
+}
+
+/*
+ * Draw all dirty cells and update the terminal with a single refresh.
+ * The cursor is left at the last location displayed.
+ */
+
+void
+display_flush (void)
+{
+	int i;
+	long loc;
+
+	if (redraw_pending) {
+		if (frame_due ())
+			draw_sector ();
+		return;
+	}
+	if (dirty_count == 0 || !frame_due ())
+		return;
+
+	if (whose_map != UNOWNED)
+		for (i = 0; i < dirty_count; i++) {
+			loc = dirty_list[i];
+			if (on_screen (loc)) {
+				wmove(mapwin, loc_row(loc)-ref_row+1, loc_col(loc)-ref_col+1);
+				disp_square(dirty_vmap, loc);
+			}
+		}
+	dirty_clear ();
+
+	if (whose_map != UNOWNED && on_screen (save_cursor))
+		wmove(mapwin, loc_row(save_cursor)-ref_row+1, loc_col(save_cursor)-ref_col+1);
+	wnoutrefresh(mapwin);
+	doupdate();
+}
+
+/*
+ * Start or stop holding the display.  When the hold is released, anything
+ * not yet drawn is drawn immediately.
+ */
+
+void
+display_hold (int on)
+{
+	if (frame_rate < 0 || held == on)
+		return;
+
+	held = on;
+	if (!held)
+		display_flush ();
+}
+
+/*
+ * Return TRUE if the screen may be updated now.  If so, we assume
+ * the caller is going to update it.
+ */
+
+static int
+frame_due (void)
+{
+	long now;
+
+	if (!held)
+		return (TRUE);
+	if (frame_rate == 0)
+		return (FALSE);
+
+	now = clock_ms ();
+	if (now - last_frame < 1000 / frame_rate)
+		return (FALSE);
+
+	last_frame = now;
+	return (TRUE);
+}
+
+/* Forget about any cells waiting to be drawn. */
+
+static void
+dirty_clear (void)
+{
+	int i;
+
+	for (i = 0; i < dirty_count; i++)
+		dirty[dirty_list[i]] = FALSE;
+	dirty_count = 0;
 }
 
 /*
@@ -173,10 +293,10 @@ print_sector (char whose, view_map_t vmap[], int sector)
 {
 	int first_row, first_col, last_row, last_col;
 	int display_rows, display_cols;
-	int r, c;
 
 	save_sector = sector; /* remember last sector displayed */
 	change_ok = FALSE; /* we are displaying a new sector */
+	dirty_clear (); /* whole screen is about to be drawn */
 
 	display_rows = MAPWIN_HEIGHT - 2; /* num lines to display */
 	display_cols = MAPWIN_WIDTH - 2;
@@ -190,7 +310,7 @@ print_sector (char whose, view_map_t vmap[], int sector)
 	if ((whose != whose_map)
 		    || (!on_screen(row_col_loc(first_row, first_col)))
 		    || (!on_screen(row_col_loc(last_row, last_col))))
-		wclear(mapwin); /* erase current screen */
+		clear_pending = TRUE; /* erase current screen */
 
 	/* figure out first row and col to print; subtract half the extra lines from the first line */
 
@@ -213,7 +333,35 @@ print_sector (char whose, view_map_t vmap[], int sector)
 		ref_col = 1;
 
         whose_map = whose; /* remember whose map is displayed */
-	display_screen (vmap);
+	sector_vmap = vmap;
+	redraw_pending = TRUE;
+
+	if (frame_due ())
+		draw_sector ();
+}
+
+/*
+ * Draw the sector chosen by print_sector, along with the coordinates
+ * and round number around the edge of the map.
+ */
+
+static void
+draw_sector (void)
+{
+	int display_rows, display_cols;
+	int r, c;
+
+	redraw_pending = FALSE;
+	dirty_clear (); /* every cell is drawn below */
+
+	display_rows = MAPWIN_HEIGHT - 2; /* num lines to display */
+	display_cols = MAPWIN_WIDTH - 2;
+
+	if (clear_pending)
+		wclear(mapwin); /* erase current screen */
+	clear_pending = FALSE;
+
+	display_screen (sector_vmap);
 
 	/* print x-coordinates along bottom of screen */
 	wmove(stdscr, lines-1, 0);
@@ -233,7 +381,7 @@ print_sector (char whose, view_map_t vmap[], int sector)
 		}
 	
 	/* print round number */
-	snprintf (jnkbuf, STRSIZE, "Sector %d Round %ld", sector, date);
+	snprintf (jnkbuf, STRSIZE, "Sector %d Round %ld", save_sector, date);
 	for (r = 0; jnkbuf[r] != '\0'; r++)
 	{
 		if (r+NUMTOPS + 2 >= MAP_HEIGHT)
@@ -242,7 +390,8 @@ print_sector (char whose, view_map_t vmap[], int sector)
 		mvwaddch(stdscr, r+NUMTOPS + 2, cols-NUMSIDES+4, jnkbuf[r]);
 	}
 
-	wrefresh(stdscr);
+	wnoutrefresh(stdscr);
+	doupdate();
 }
 
 /* Display the contents of a single map square. */
@@ -279,7 +428,7 @@ display_screen (view_map_t vmap[])
 			disp_square(vmap, t);
 		}
 	box(mapwin, 0, 0);
-	wrefresh(mapwin);
+	wnoutrefresh(mapwin);
 }
 
 /*
@@ -343,6 +492,31 @@ on_screen (long loc)
 
 char zoom_list[] = "XO*tcbsdpfaTCBSDPFAzZ+. ";
 
+/*
+ * A cell shows whichever of its contents comes first in zoom_list.
+ * zoom_rank gives the position of each character in the list, so we
+ * don't have to search the list for every cell.  Characters not in
+ * the list come before all the others.
+ */
+
+static int zoom_rank[UCHAR_MAX+1];
+static int zoom_ranked;
+
+#define ZOOM_RANK(c) zoom_rank[(unsigned char)(c)]
+
+static void
+rank_zoom_list (void)
+{
+	int c;
+	char *p;
+
+	for (c = 0; c <= UCHAR_MAX; c++) {
+		p = strchr (zoom_list, c);
+		zoom_rank[c] = p ? p - zoom_list : -1;
+	}
+	zoom_ranked = TRUE;
+}
+
 void
 print_zoom (const view_map_t *vmap)
 {
@@ -352,6 +526,7 @@ print_zoom (const view_map_t *vmap)
 	row_inc = (MAP_HEIGHT + MAPWIN_HEIGHT - 2) / (MAPWIN_HEIGHT - 2);
 	col_inc = (MAP_WIDTH + MAPWIN_WIDTH - 2) / (MAPWIN_WIDTH - 2);
 
+	dirty_clear (); /* sector is redrawn when we are done */
 	wclear(mapwin);
 
 	for (r = 0; r < MAP_HEIGHT; r += row_inc)
@@ -406,10 +581,12 @@ print_zoom_cell (const view_map_t *vmap, int row, int col, int row_inc, int col_
 	int r, c;
 	char cell;
 
+	if (!zoom_ranked) rank_zoom_list ();
+
 	cell = ' ';
 	for (r = row; r < row + row_inc; r++)
 		for (c = col; c < col + col_inc; c++)
-			if (strchr(zoom_list, vmap[row_col_loc(r,c)].contents) < strchr(zoom_list, cell))
+			if (ZOOM_RANK (vmap[row_col_loc(r,c)].contents) < ZOOM_RANK (cell))
 				cell = vmap[row_col_loc(r,c)].contents;
 	
 	wmove (mapwin, row/row_inc + 1, col/col_inc + 1);
@@ -425,6 +602,7 @@ print_pzoom (char *s, const path_map_t *pmap, const view_map_t *vmap)
 	int row_inc, col_inc;
 	int r, c;
 
+	dirty_clear (); /* sector is redrawn when we are done */
 	wclear(mapwin);
 
         row_inc = (MAP_HEIGHT + MAPWIN_HEIGHT - 2) / (MAPWIN_HEIGHT - 2);
@@ -551,6 +729,8 @@ print_movie_screen(const char *mapbuf)
 	int r, c, i, j;
 	char cell;
 
+	if (!zoom_ranked) rank_zoom_list ();
+
 	row_inc = (MAP_HEIGHT + lines - NUMTOPS - 2) / (lines - NUMTOPS);
 	col_inc = (MAP_WIDTH + cols - 1) / (cols - 1);
 
@@ -561,7 +741,7 @@ print_movie_screen(const char *mapbuf)
 
 			for (i = r; i < r + row_inc; i++)
 				for (j = c; j < c + col_inc; j++)
-					if (strchr(zoom_list, mapbuf[row_col_loc(i,j)]) < strchr(zoom_list, cell))
+					if (ZOOM_RANK (mapbuf[row_col_loc(i,j)]) < ZOOM_RANK (cell))
 						cell = mapbuf[row_col_loc(i,j)];
 
 			mvwaddch(stdscr, r/row_inc + NUMTOPS, c/col_inc, cell);
@@ -591,6 +771,7 @@ help (const char **text, int nlines)
 	start_row = (MAPWIN_HEIGHT - help_height ) / 2 + NUMTOPS + 1;
 	start_col = (MAPWIN_WIDTH - help_width) / 2 + 2;
 
+	display_flush (); /* don't draw map cells over the help window */
 	helpwin = newwin(help_height, help_width, start_row, start_col);
 
 	if (helpwin == NULL)
@@ -48,9 +48,12 @@ empire (void)
 	while(1)
 	{
 		/* until user quits */
+		save_poll(); /* report on any finished save */
+
 		if (automove)
 		{
 			/* don't ask for cmd in auto mode */
+			display_hold(TRUE); /* limit screen updates */
 			user_move();
 			comp_move();
 			if (++turn % save_interval == 0)
@@ -58,6 +61,7 @@ empire (void)
 	    	}
 	   	else
 		{
+			display_hold(FALSE);
 	        	prompt("Your orders? ");
 	        	order = get_chx(); /* get a command */
 			do_command(order);
@@ -77,6 +81,7 @@ do_command (char orders)
 	case 'A': /* turn on auto move mode */
 		automove = TRUE;
 		info("Entering Auto-Mode");
+		display_hold(TRUE);
 		user_move();
 		comp_move();
 		save_game();
@@ -151,8 +156,10 @@ do_command (char orders)
 		save_movie = !save_movie;
 		if (save_movie)
 			info("Saving movie screens to 'empmovie.dat'.");
-		else
+		else {
+			movie_close();
 			info("No longer saving movie screens.");
+		}
 		break;
 
 	case 'W': /* watch movie */
@@ -216,6 +223,7 @@ c_give (void)
 	i = rand_long (count);
 	i = unowned[i]; /* get city index */
 	city[i].owner = COMP;
+	city_changed ();
 	city[i].prod = NOPIECE;
 	city[i].work = 0;
 	scan (comp_map, city[i].loc);
@@ -356,6 +364,7 @@ emp_start (void)
 	term_init();	/* init tty, and info and status windows */
 	map_init();	/* init map window */
 	rand_init();	/* init random number generator */
+	dist_init();	/* init distance table */
 }
 
 /* This provides a single place for collecting all cleanup routines */
@@ -363,6 +372,8 @@ emp_start (void)
 static void
 emp_end (void)
 {
+	save_wait();	/* don't lose a save in progress */
+	movie_close();
 	term_end();
 	exit(0);
 }
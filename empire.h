@@ -36,6 +36,8 @@
 
 #define INFINITY 1000000 /* a large number */
 
+#define ODDS_ONE (1L << 24) /* certainty, when giving the chance of something */
+
 #define T_UNKNOWN 0
 #define T_PATH 1
 #define T_LAND 2
@@ -189,11 +191,15 @@ typedef struct
         piece_info_t *objp;	/* list of objects at this location	*/
 } real_map_t;
 
+/*
+ * A cell of one player's world view.  The date each cell was last
+ * updated is kept apart, in user_seen and comp_seen, so that the view
+ * maps the computer copies and searches take one byte per cell.
+ */
+
 typedef struct
 {
-        /* a cell of one player's world view */
         unsigned char contents;		/* '+', '.', '*', 'A', 'a', etc	*/
-        long seen;		/* date when last updated	*/
 } view_map_t;
 
 /* Define information we maintain for a pathmap. */
@@ -14,12 +14,17 @@ extern int SMOOTH;		/* number of times to smooth map		*/
 extern int WATER_RATIO;		/* percentage of map that is water		*/
 extern int MIN_CITY_DIST;	/* cities must be at least this far apart	*/
 extern int save_interval;	/* turns between autosaves			*/
+extern int journal_interval;	/* saves per full checkpoint, 0 = no journal	*/
 extern int traditional;		/* use `traditional' movement keys instead of new style */
 extern int color;		/* use color if available			*/
+extern int frame_rate;		/* automove screen updates per second, -1 = all */
+extern int comp_budget;		/* milliseconds for moving computer pieces, 0 = no limit */
 
 extern real_map_t map[MAP_SIZE];	/* the way the world really looks	*/
 extern view_map_t comp_map[MAP_SIZE];	/* computer's view of the world		*/
 extern view_map_t user_map[MAP_SIZE];	/* user's view of the world		*/
+extern int comp_seen[MAP_SIZE];		/* date each cell of comp_map was updated */
+extern int user_seen[MAP_SIZE];		/* date each cell of user_map was updated */
 
 extern city_info_t city[NUM_CITY];	/* city information			*/
 
@@ -109,14 +114,21 @@ extern int comp_score;
 
 /* global routines */
 void	attack (piece_info_t *, long);	/* attack.c	*/
+long	attack_odds (piece_type_t, int, piece_type_t, int); /* attack.c */
+long	invade_odds (int, int);		/* attack.c	*/
+void	comp_map_changed (long);	/* compmove.c	*/
+void	comp_map_reloaded (void);	/* compmove.c	*/
 void	comp_move (void);		/* compmove.c	*/
 void    edit(long);            		/* edit.c	*/
 void    empire (void);          	/* empire.c	*/
 void	user_move (void);		/* usermove.c	*/
+void	user_sector_changed (int);	/* usermove.c	*/
 
 /* display routines (display.c) */
 void	map_init (void);
 int	cur_sector (void);
+void	display_flush (void);
+void	display_hold (int);
 void	display_loc (int, view_map_t[], long);
 void	display_locx (int, view_map_t[], long);
 void    display_score (void);
@@ -140,12 +152,22 @@ void    e_city_wake (city_info_t *, int);
 
 /* game routines (game.c) */
 void	init_game (void);
-void	replay_movie (void);
 int	restore_game (void);
 void	save_game (void);
+void	save_poll (void);
+void	save_wait (void);
+
+/* movie routines (movie.c) */
+void	movie_close (void);
+int	movie_stats (void);
+void	replay_movie (void);
 void	save_movie_screen (void);
 
 /* map routines (map.c) */
+int	*cmap_get (void);
+void	cmap_put (int *);
+path_map_t	*pmap_get (void);
+void	pmap_put (path_map_t *);
 int	rmap_shore (long);
 int	vmap_at_sea (const view_map_t *, long);
 void	vmap_cont (int *, const view_map_t *, long, char);
@@ -165,11 +187,13 @@ void	vmap_prune_explore_locs (view_map_t *);
 
 /* math routines (math.c) */
 long	dist (long, long);
+void	dist_init (void);
 long	rand_long (long);
 int	isqrt (int);
 void	rand_init (void);
 
 /* object routines (object.c) */
+void	city_changed (void);
 void	describe_obj (const piece_info_t *);
 void	disembark (piece_info_t *);
 void	embark (piece_info_t *, piece_info_t *);
@@ -189,6 +213,7 @@ int	obj_capacity (const piece_info_t *);
 int	obj_moves (const piece_info_t *);
 void	produce (city_info_t *);
 void	scan (view_map_t[], long);
+void	scan_side (int);
 void	set_prod (city_info_t *);
 
 /* terminal routines (term.c) */
@@ -208,4 +233,5 @@ void    term_init (void);
 
 /* utility routines (util.c) */
 void    check (void);
+long	clock_ms (void);
 void	emp_panic (const char *file, int line, const char *);
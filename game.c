@@ -11,9 +11,15 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #include "empire.h"
 #include "extern.h"
 
@@ -21,38 +27,65 @@
 #include <zlib.h>
 typedef gzFile file;
 #define open_file(f, m) gzopen(f, m)
+#define dopen_file(fd, m) gzdopen(fd, m)
 #define close_file(f) gzclose(f)
 #define read_file(f, b, s) gzread(f, b, s)
 #define write_file(f, b, s) gzwrite(f, b, s)
 #else
 typedef FILE *file;
 #define open_file(x, y) fopen(x, y)
+#define dopen_file(fd, m) fdopen(fd, m)
 #define close_file(x) fclose(x)
 #define read_file(f, b, s) fread(b, 1, s, f)
 #define write_file(f, b, s) fwrite(b, 1, s, f)
 #endif
 
 void	init_game (void);
-void	replay_movie (void);
 int	restore_game (void);
 void	save_game (void);
-void	save_movie_screen (void);
+void	save_poll (void);
+void	save_wait (void);
+static int	city_cmp (const void *, const void *);
 static void	find_cont (void);
-static int	find_next (long *);
-static int	good_cont (long);
+static int	good_cont (long, long);
+static int	index_cmp (const void *, const void *);
+static void	apply_delta (void);
+static unsigned long	checksum (const unsigned char *, long);
+static unsigned long	get8 (void);
+static unsigned long	get16 (void);
+static unsigned long	get32 (void);
+static void	get_city (city_info_t *);
+static void	get_globals (void);
+static void	get_heads (void);
+static long	get_piece (void);
 static void	inconsistent (void);
+static void	list_piece (long);
 static void	make_map (void);
+static void	label_cont (void);
 static void	make_pair (void);
-static void	mark_cont (long);
+static piece_info_t	*live_obj (int);
+static void	pack_delta (void);
+static void	pack_game (void);
 static void	place_cities (void);
-static void	read_embark (piece_info_t *, piece_type_t);
-static long	remove_land (long, long);
+static void	put8 (unsigned long);
+static void	put16 (unsigned long);
+static void	put32 (unsigned long);
+static void	put_city (const city_info_t *);
+static void	put_globals (void);
+static void	put_heads (void);
+static void	put_piece (long);
+static void	relink (int, int, int);
+static unsigned long	replay_journal (int *);
+static void	save_report (int);
+static int	write_save (void);
 static long	regen_land (long);
-static long    remove_land (long, long);
+static long	remove_land (long, long);
 static int	select_cities (void);
-static void	stat_display (char *, int);
-static int	xread (file, void *, int);
-static int	xwrite (file, void *, int);
+static long	select_land (long);
+static void	smooth_map (const int *, int *);
+static void	snap_pieces (void);
+static void	snap_shadow (void);
+static void	unpack_pieces (void);
 /*
  * Initialize a new game.  Here we generate a new random map, put cities
  * on the map, select cities for each opponent, and zero out the lists of
@@ -81,9 +114,9 @@ init_game (void)
 	for (i = 0; i < MAP_SIZE; i++)
 	{
 		user_map[i].contents = ' '; /* nothing seen yet */
-		user_map[i].seen = 0;
+		user_seen[i] = 0;
 		comp_map[i].contents = ' ';
-		comp_map[i].seen = 0;
+		comp_seen[i] = 0;
 	}
 
 	for (j = FIRST_OBJECT; j < NUM_OBJECTS; j++)
@@ -104,6 +137,7 @@ init_game (void)
 	}
 
 	make_map(); /* make land and water */
+	label_cont(); /* find the continents */
 
 	do
 	{
@@ -135,6 +169,7 @@ init_game (void)
 /* these arrays give some compilers problems when they are automatic */
 static int height[2][MAP_SIZE];
 static int height_count[MAX_HEIGHT+1];
+static int row_sum[MAP_SIZE];
 
 static void
 make_map (void)
@@ -148,16 +183,7 @@ make_map (void)
 	from = 0;
 	to = 1;
 	for (i = 0; i < SMOOTH; i++) { /* smooth the map */
-	    for (j = 0; j < MAP_SIZE; j++) {
-		sum = height[from][j];
-		for (k = 0; k < 8; k++) {
-			loc = j + dir_offset[k];
-			/* edges get smoothed in a wierd fashion */
-			if (loc < 0 || loc >= MAP_SIZE) loc = j;
-			sum += height[from][loc];
-		}
-		height[to][j] = sum / 9;
-	    }
+	    smooth_map (height[from], height[to]);
 	    k = to; /* swap to and from */
 	    to = from;
 	    from = k;
@@ -167,7 +193,7 @@ make_map (void)
 	for (i = 0; i <= MAX_HEIGHT; i++)
 		height_count[i] = 0;
 
-	for (i = 0; i <= MAP_SIZE; i++)
+	for (i = 0; i < MAP_SIZE; i++)
 		height_count[height[from][i]]++;
 
 	/* find the water line */
@@ -198,16 +224,64 @@ make_map (void)
 	}
 }
 
+/*
+ * Smooth the map once, replacing each height with the average of it
+ * and its eight neighbors.  The filter is separable, so we first add
+ * up each cell and its left and right neighbors, and then add three
+ * of those sums from the rows above and below.  Both loops are simple
+ * enough for the compiler to vectorize.
+ *
+ * The map is treated as one long row, so cells on the left and right
+ * edges take neighbors from the adjacent rows.  A neighbor off the top
+ * or bottom of the map is replaced by the cell itself; the few cells
+ * this affects are done one at a time.
+ */
+
+static void
+smooth_map (const int *from, int *to)
+{
+	long j, loc, sum;
+	int k;
+
+	for (j = 1; j < MAP_SIZE-1; j++)
+		row_sum[j] = from[j-1] + from[j] + from[j+1];
+
+	for (j = MAP_WIDTH+1; j < MAP_SIZE-MAP_WIDTH-1; j++)
+		to[j] = (row_sum[j-MAP_WIDTH] + row_sum[j] + row_sum[j+MAP_WIDTH]) / 9;
+
+	for (j = 0; j < MAP_SIZE; j++) {
+		if (j == MAP_WIDTH+1) /* skip the cells done above */
+			j = MAP_SIZE-MAP_WIDTH-1;
+		sum = from[j];
+		for (k = 0; k < 8; k++) {
+			loc = j + dir_offset[k];
+			/* edges get smoothed in a wierd fashion */
+			if (loc < 0 || loc >= MAP_SIZE) loc = j;
+			sum += from[loc];
+		}
+		to[j] = sum / 9;
+	}
+}
+
 /*
  * Randomly place cities on the land.  There is a minimum distance that
  * should exist between cities.  We maintain a list of acceptable land cells
  * on which a city may be placed.  We randomly choose elements from this
  * list until all the cities are placed.  After each choice of a land cell
  * for a city, we remove land cells which are too close to the city.
+ *
+ * Cells are never moved within the list; instead we keep a count of the
+ * acceptable cells in a binary indexed tree, so that we can find the
+ * n'th acceptable cell, or remove one, in time proportional to the log
+ * of the amount of land.  Only the cells in a square around a new city
+ * can be too close to it, so those are the only ones we look at.
  */
 
 /* avoid compiler problems with large automatic arrays */
-static long land[MAP_SIZE];
+static long land[MAP_SIZE];		/* all land cells, in map order */
+static long land_index[MAP_SIZE];	/* index of acceptable cell in land, or -1 */
+static long land_tree[MAP_SIZE+1];	/* counts of acceptable cells */
+static long land_size;			/* number of cells in land */
 
 static void
 place_cities (void)
@@ -221,7 +295,7 @@ place_cities (void)
 	while (placed < NUM_CITY) {
 		while (num_land == 0) num_land = regen_land (placed);
 		i = rand_long (num_land-1); /* select random piece of land */
-		loc = land[i];
+		loc = select_land (i);
 		
 		city[placed].loc = loc;
 		city[placed].owner = UNOWNED;
@@ -250,15 +324,25 @@ static long
 regen_land (long placed)
 {
 	long num_land;
-	long i;
+	long i, j;
 
-	num_land = 0;
+	land_size = 0;
 	for (i = 0; i < MAP_SIZE; i++) {
+		land_index[i] = -1;
 		if (map[i].on_board && map[i].contents == '+') {
-			land[num_land] = i; /* remember piece of land */
-			num_land++; /* remember number of pieces */
+			land_index[i] = land_size;
+			land[land_size] = i; /* remember piece of land */
+			land_size++; /* remember number of pieces */
 		}
 	}
+	for (i = 1; i <= land_size; i++) /* every cell is acceptable */
+		land_tree[i] = 1;
+	for (i = 1; i <= land_size; i++) {
+		j = i + (i & -i);
+		if (j <= land_size) land_tree[j] += land_tree[i];
+	}
+	num_land = land_size;
+
 	if (placed > 0) { /* don't decrement 1st time */
 		MIN_CITY_DIST -= 1;
 		assert (MIN_CITY_DIST >= 0);
@@ -269,21 +353,55 @@ regen_land (long placed)
 	return (num_land);
 }
 
-/* Remove land that is too close to a city. */
+/*
+ * Remove land that is too close to a city.  dist is never less than
+ * the row or column difference, so nothing outside the square of cells
+ * less than MIN_CITY_DIST rows and columns away can be too close.
+ */
 
 static long
 remove_land (long loc, long num_land)
 {
-	long new, i;
+	long r, c, r0, r1, c0, c1, i, j;
+
+	r0 = loc_row (loc) - MIN_CITY_DIST + 1;
+	r1 = loc_row (loc) + MIN_CITY_DIST - 1;
+	c0 = loc_col (loc) - MIN_CITY_DIST + 1;
+	c1 = loc_col (loc) + MIN_CITY_DIST - 1;
+	if (r0 < 0) r0 = 0;
+	if (r1 > MAP_HEIGHT-1) r1 = MAP_HEIGHT-1;
+	if (c0 < 0) c0 = 0;
+	if (c1 > MAP_WIDTH-1) c1 = MAP_WIDTH-1;
+
+	for (r = r0; r <= r1; r++)
+	for (c = c0; c <= c1; c++) {
+		i = row_col_loc (r, c);
+		if (land_index[i] < 0 || dist (loc, i) >= MIN_CITY_DIST)
+			continue;
+		for (j = land_index[i] + 1; j <= land_size; j += j & -j)
+			land_tree[j] -= 1;
+		land_index[i] = -1;
+		num_land--;
+	}
+	return (num_land);
+}
+
+/* Return the n'th acceptable land cell, counting from 0, in map order. */
 
-	new = 0; /* nothing kept yet */
-	for (i = 0; i < num_land; i++) {
-		if (dist (loc, land[i]) >= MIN_CITY_DIST) {
-			land[new] = land[i];
-			new++;
+static long
+select_land (long n)
+{
+	long pos, step;
+
+	for (step = 1; step * 2 <= land_size; step *= 2)
+		;
+	for (pos = 0; step > 0; step /= 2) {
+		if (pos + step <= land_size && land_tree[pos + step] <= n) {
+			pos += step;
+			n -= land_tree[pos];
 		}
 	}
-	return (new);
+	return (land[pos]);
 }
 
 /*
@@ -330,7 +448,6 @@ typedef struct pair {
 	int comp_cont;		/* index to computer continent	*/
 } pair_t;
 
-static int marked[MAP_SIZE];			/* list of examine cells		*/
 static int ncont;				/* number of continents			*/
 static cont_t cont_tab[MAX_CONT];		/* list of good continenets		*/
 static int rank_tab[MAX_CONT];			/* indices to cont_tab in order of rank	*/
@@ -373,82 +490,145 @@ select_cities (void)
 
 	userp->owner = USER;
 	userp->work = 0;
+	city_changed ();
 	scan (user_map, userp->loc);
 	set_prod (userp);
 	return (TRUE);
 }
 
 /*
- * Find all continents with 2 cities or more, one of which must be a shore
- * city.  We rank the continents.
+ * Label the continents.  This is done once for each new map, since
+ * placing cities does not change which cells are land.  We walk each
+ * continent depth first, looking at the neighbors of each cell in the
+ * order given by dir_offset, and number the cells in the order we
+ * reach them.  Continents are found in map order, so every cell of a
+ * continent gets a lower number than any cell of a later continent.
+ * We keep our own stack rather than recursing, since a continent can
+ * cover most of the map.
  */
 
+static long cont_seq[MAP_SIZE];		/* order in which each land cell was reached, or -1 */
+static long cont_area[MAP_SIZE];	/* land area of continent, by first cell's number */
+static long cont_first[MAP_SIZE];	/* number of first cell of each cell's continent */
+static long walk_loc[MAP_SIZE];		/* cells being walked */
+static int walk_dir[MAP_SIZE];		/* next neighbor to look at */
+
+#define cont_land(loc) (map[loc].on_board && map[loc].contents != '.')
+
 static void
-find_cont (void)
+label_cont (void)
 {
-	long i;
-	long mapi;
+	long i, loc, next, seq, first;
+	int top;
 
-	for (i = 0; i < MAP_SIZE; i++) marked[i] = 0; /* nothing marked yet */
+	for (i = 0; i < MAP_SIZE; i++) cont_seq[i] = -1; /* nothing reached yet */
 
-	ncont = 0; /* no continents found yet */
-	mapi = 0;
-
-	while (ncont < MAX_CONT)
-		if (!find_next (&mapi)) return; /* all found */
+	seq = 0;
+	for (i = 0; i < MAP_SIZE; i++) {
+		if (!cont_land (i) || cont_seq[i] >= 0) continue;
+
+		first = seq; /* a new continent */
+		cont_seq[i] = seq++;
+		cont_first[i] = first;
+		walk_loc[0] = i;
+		walk_dir[0] = 0;
+		top = 0;
+
+		while (top >= 0) {
+			if (walk_dir[top] == 8) { /* seen all neighbors */
+				top--;
+				continue;
+			}
+			loc = walk_loc[top];
+			next = loc + dir_offset[walk_dir[top]++];
+			if (!cont_land (next) || cont_seq[next] >= 0) continue;
+
+			cont_seq[next] = seq++;
+			cont_first[next] = first;
+			top++;
+			walk_loc[top] = next;
+			walk_dir[top] = 0;
+		}
+		cont_area[first] = seq - first;
+	}
 }
 
 /*
- * Find the next continent and insert it in the rank table.
- * If there are no more continents, we return false.
+ * Find all continents with 2 cities or more, one of which must be a shore
+ * city.  We rank the continents.  We sort the cities by the order in
+ * which label_cont reached them; this groups them by continent, with
+ * the continents in map order.
  */
 
+static city_info_t *city_order[NUM_CITY];
+
 static int
-find_next (long *mapi)
+city_cmp (const void *a, const void *b)
 {
-	long i, val;
+	long sa, sb;
 
-	for (;;) {
-		if (*mapi >= MAP_SIZE) return (FALSE);
+	sa = cont_seq[(*(city_info_t * const *)a)->loc];
+	sb = cont_seq[(*(city_info_t * const *)b)->loc];
+	return (sa < sb ? -1 : sa > sb);
+}
 
-		if (!map[*mapi].on_board || marked[*mapi]
-			|| map[*mapi].contents == '.') *mapi += 1;
-		else if (good_cont (*mapi)) {
-			rank_tab[ncont] = ncont; /* insert cont in rank tab */
-			val = cont_tab[ncont].value;
+static void
+find_cont (void)
+{
+	long i, j, val;
+	int k;
+
+	for (i = 0; i < NUM_CITY; i++) {
+		city_order[i] = &city[i];
+		assert (cont_seq[city[i].loc] >= 0);
+	}
+	qsort (city_order, NUM_CITY, sizeof (city_order[0]), city_cmp);
+
+	ncont = 0; /* no continents found yet */
+
+	for (i = 0; i < NUM_CITY && ncont < MAX_CONT; i = j) {
+		for (j = i + 1; j < NUM_CITY && cont_first[city_order[j]->loc]
+		    == cont_first[city_order[i]->loc]; j++)
+			;
+		if (!good_cont (i, j)) continue;
 
-			for (i = ncont; i > 0; i--) { /* bubble up new rank */
-				if (val > cont_tab[rank_tab[i-1]].value) {
-					rank_tab[i] = rank_tab[i-1];
-					rank_tab[i-1] = ncont;
-				}
-				else break;
+		rank_tab[ncont] = ncont; /* insert cont in rank tab */
+		val = cont_tab[ncont].value;
+
+		for (k = ncont; k > 0; k--) { /* bubble up new rank */
+			if (val > cont_tab[rank_tab[k-1]].value) {
+				rank_tab[k] = rank_tab[k-1];
+				rank_tab[k-1] = ncont;
 			}
-			ncont++; /* count continents */
-			return (TRUE);
+			else break;
 		}
+		ncont++; /* count continents */
 	}
 }
 
 /*
- * Map out the current continent.  We mark every piece of land on the continent,
- * count the cities, shore cities, and land area of the continent.  If the
- * continent contains 2 cities and a shore city, we set the value of the
- * continent and return true.  Otherwise we return false.
+ * Look at the continent holding the cities from city_order[first] up
+ * to city_order[last].  We count the cities and shore cities, and find
+ * the land area of the continent.  If the continent contains 2 cities
+ * and a shore city, we set the value of the continent and return true.
+ * Otherwise we return false.
  */
 
-static long ncity, nland, nshore;
-
 static int
-good_cont (long mapi)
+good_cont (long first, long last)
 {
-	long val;
+	long val, ncity, nland, nshore, i;
 
 	ncity = 0; /* nothing seen yet */
-	nland = 0;
 	nshore = 0;
+	nland = cont_area[cont_first[city_order[first]->loc]];
 
-	mark_cont (mapi);
+	for (i = first; i < last; i++) {
+		cont_tab[ncont].cityp[ncity] = city_order[i];
+		ncity++;
+		if (rmap_shore(city_order[i]->loc))
+			nshore++;
+	}
 
 	if (nshore < 1 || ncity < 2) return (FALSE);
 
@@ -469,36 +649,6 @@ good_cont (long mapi)
 	return (TRUE);
 }
 
-/*
- * Mark a continent.  This recursive algorithm marks the current square
- * and counts it if it is land or city.  If it is city, we also check
- * to see if it is a shore city, and we install it in the list of
- * cities for the continent.  We then examine each surrounding cell.
- */
-
-static void
-mark_cont (long mapi)
-{
-	int i;
-
-	if (marked[mapi] || map[mapi].contents == '.'
-		|| !map[mapi].on_board) return;
-
-	marked[mapi] = 1;	/* mark this cell seen		*/
-	nland++;		/* count land on continent	*/
-
-	if (map[mapi].contents == '*')
-	{ /* a city? */
-		cont_tab[ncont].cityp[ncity] = map[mapi].cityp;
-		ncity++;
-		if (rmap_shore(mapi))
-			nshore++;
-	}
-
-	for (i = 0; i < 8; i++) /* look at surrounding squares */
-		mark_cont (mapi + dir_offset[i]);
-}
-
 /*
  * Create a list of pairs of continents in a ranked order.  The first
  * element in the list is the pair which is easiest for the user to
@@ -537,345 +687,1034 @@ make_pair (void)
  * Save a game.  We save the game in emp_save.dat.  Someday we may want
  * to ask the user for a file name.  If we cannot save the game, we will
  * tell the user why.
+ *
+ * The save file is written field by field in a fixed little-endian
+ * layout, so that it does not depend on the compiler or machine that
+ * wrote it.  It starts with a header:
+ *
+ *	magic		8 bytes, "EMPSAVE" and a NUL
+ *	version		16 bits, SAVE_VERSION
+ *	map width	16 bits
+ *	map height	16 bits
+ *	cities		16 bits
+ *	piece types	16 bits
+ *	object slots	16 bits
+ *	generation	32 bits, identifies this checkpoint to the journal
+ *	live pieces	32 bits
+ *
+ * followed by the game globals, the real map contents, the contents and
+ * dates of both view maps, the cities, the heads of each piece list,
+ * and finally one record for each live piece.  Pieces are identified by
+ * their index in the object array.  Piece records are written in the
+ * order they appear in each location's list; the piece and cargo lists
+ * are recorded as indices of the next piece.  Nothing which can be
+ * recomputed (whether a cell is on the board, the city and object
+ * pointers in the real map, the free list) is saved.
+ *
+ * If journaling is turned on (journal_interval > 0), only every
+ * journal_interval'th save writes a complete checkpoint like this.
+ * The saves in between append a delta to empsave.log holding just what
+ * changed since the previous save:
+ *
+ *	magic		8 bytes, "EMPJRNL" and a NUL
+ *	generation	32 bits, generation of the checkpoint it follows
+ *	sequence	32 bits, 1 for the first delta after a checkpoint
+ *	length		32 bits, bytes of data which follow
+ *	globals
+ *	list heads
+ *	view cells	32 bit count, then loc, map, contents, date for each
+ *	cities		16 bit count, then index and city for each
+ *	pieces		16 bit count, then for each a live flag followed by
+ *			the piece and the next piece at its location, or
+ *			the index of a piece which was killed
+ *	checksum	32 bits, over everything above
+ *
+ * Restoring reads the checkpoint and then replays deltas in order,
+ * stopping at the first one that is damaged or out of sequence.
  */
 
-/* macro to save typing; write an array, return if it fails */
-#define wbuf(buf) if (!xwrite (f, (void *)buf, sizeof (buf))) return
-#define wval(val) if (!xwrite (f, (void *)&val, sizeof (val))) return
+#define SAVE_MAGIC "EMPSAVE"
+#define SAVE_VERSION 3
+#define SAVE_HEADER (8 + 6 * 2 + 4 + 4)
+#define SAVE_GLOBALS (4 + 4 + 4 + 4 + 4)
+#define SAVE_CITY (4 + 1 + 4 * NUM_OBJECTS + 4 + 1)
+#define SAVE_PIECE (2 + 1 + 1 + 4 + 4 + 8 * 2)
+#define SAVE_HEADS (2 * NUM_OBJECTS * 2)
+#define SAVE_MAX (SAVE_HEADER + SAVE_GLOBALS + MAP_SIZE + 2 * MAP_SIZE * 5 \
+	+ NUM_CITY * SAVE_CITY + SAVE_HEADS + LIST_SIZE * SAVE_PIECE)
+
+#define JOURNAL_MAGIC "EMPJRNL"
+#define JOURNAL_HEADER (8 + 4 + 4 + 4)
+#define JOURNAL_MAX (JOURNAL_HEADER + SAVE_GLOBALS + SAVE_HEADS \
+	+ 4 + 2 * MAP_SIZE * 8 + 2 + NUM_CITY * (2 + SAVE_CITY) \
+	+ 2 + LIST_SIZE * (1 + SAVE_PIECE + 2) + 4)
+
+#define SAVE_BUF_MAX (SAVE_MAX > JOURNAL_MAX ? SAVE_MAX : JOURNAL_MAX)
+
+static unsigned char save_buf[SAVE_BUF_MAX];
+static long save_len; /* bytes used in save_buf */
+static long save_pos; /* read position in save_buf */
+
+/* a piece as it appears in the save file */
+typedef struct
+{
+	unsigned char	owner;		/* UNOWNED if slot is free	*/
+	unsigned char	type;
+	long		loc;
+	long		func;
+	int		hits, moved, range, count;
+	int		ship, cargo;	/* object indices or -1		*/
+	int		next;		/* next piece in piece list	*/
+	int		cargo_next;	/* next piece in cargo list	*/
+	int		loc_next;	/* next piece at this location	*/
+} save_piece_t;
+
+static save_piece_t save_tab[LIST_SIZE]; /* pieces being saved or restored */
+static int save_heads[2][NUM_OBJECTS]; /* heads of user, comp piece lists */
+
+/* the slots of save_tab which may hold a piece; all others are UNOWNED */
+static int save_live[LIST_SIZE];
+static long save_nlive;
+static unsigned char save_listed[LIST_SIZE]; /* TRUE if in save_live */
+
+/* the game as of the last save, for computing journal deltas */
+static save_piece_t shadow_tab[LIST_SIZE];
+static int shadow_heads[2][NUM_OBJECTS];
+static view_map_t shadow_comp[MAP_SIZE];
+static view_map_t shadow_user[MAP_SIZE];
+static int shadow_comp_seen[MAP_SIZE];
+static int shadow_user_seen[MAP_SIZE];
+static city_info_t shadow_city[NUM_CITY];
+
+static unsigned long generation; /* generation of the last checkpoint */
+static int journal_ok; /* TRUE if shadow matches what is on disk */
+static unsigned long journal_seq; /* deltas written since the last checkpoint */
+
+/* index of a piece, or -1 if there is none */
+#define obj_index(p) ((p) == NULL ? -1 : (int)((p) - object))
 
-void
-save_game (void)
+static void
+put8 (unsigned long val)
 {
-	file f; /* file to save game in */
+	assert (save_len < SAVE_BUF_MAX);
+	save_buf[save_len++] = val & 0xff;
+}
 
-	f = open_file("empsave.dat", "w"); /* open for output */
-	if (f == NULL) {
-		error ("Cannot save empsave.dat");
-		return;
-	}
-	wbuf (map);
-	wbuf (comp_map);
-	wbuf (user_map);
-	wbuf (city);
-	wbuf (object);
-	wbuf (user_obj);
-	wbuf (comp_obj);
-	wval (free_list);
-	wval (date);
-	wval (automove);
-	wval (resigned);
-	wval (debug);
-	wval (win);
-	wval (save_movie);
-	wval (user_score);
-	wval (comp_score);
+static void
+put16 (unsigned long val)
+{
+	put8 (val);
+	put8 (val >> 8);
+}
 
-	close_file(f);
-	info("Game saved.");
+static void
+put32 (unsigned long val)
+{
+	put16 (val);
+	put16 (val >> 16);
+}
+
+static unsigned long
+get8 (void)
+{
+	if (save_pos >= save_len) /* caller checks lengths; never happens */
+		inconsistent ();
+	return (save_buf[save_pos++]);
+}
+
+static unsigned long
+get16 (void)
+{
+	unsigned long val;
+
+	val = get8 ();
+	return (val | get8 () << 8);
+}
+
+static unsigned long
+get32 (void)
+{
+	unsigned long val;
+
+	val = get16 ();
+	return (val | get16 () << 16);
+}
+
+/* sign extend values read back from the save file */
+#define gets16() ((int)(short)get16 ())
+#define gets32() ((long)(int)get32 ())
+
+/* 32 bit FNV-1a hash, used to check journal records */
+
+static unsigned long
+checksum (const unsigned char *buf, long len)
+{
+	unsigned long h;
+
+	h = 2166136261UL;
+	while (len-- > 0) {
+		h ^= *buf++;
+		h = (h * 16777619UL) & 0xffffffffUL;
+	}
+	return (h);
 }
 
 /*
- * Recover a saved game from emp_save.dat.
- * We return TRUE if we succeed, otherwise FALSE.
+ * Fill in save_tab and save_heads from the live pieces.
  */
 
-#define rbuf(buf) if (!xread (f, (void *)buf, sizeof(buf))) return (FALSE);
-#define rval(val) if (!xread (f, (void *)&val, sizeof(val))) return (FALSE);
-
-int
-restore_game (void)
+static void
+snap_pieces (void)
 {
-	file f; /* file to save game in */
 	long i;
-	piece_type_t j;
-	piece_info_t **list;
+	int j;
 	piece_info_t *obj;
-
-	f = open_file("empsave.dat", "r"); /* open for input */
-	if (f == NULL) {
-		error("Cannot open empsave.dat");
-		return (FALSE);
-	}
-	rbuf (map);
-	rbuf (comp_map);
-	rbuf (user_map);
-	rbuf (city);
-	rbuf (object);
-	rbuf (user_obj);
-	rbuf (comp_obj);
-	rval (free_list);
-	rval (date);
-	rval (automove);
-	rval (resigned);
-	rval (debug);
-	rval (win);
-	rval (save_movie);
-	rval (user_score);
-	rval (comp_score);
-
-	/* Our pointers may not be valid because of source
-	changes or other things.  We recreate them. */
-	
-	free_list = NULL; /* zero all ptrs */
-	for (i = 0; i < MAP_SIZE; i++)
-	{
-		map[i].cityp = NULL;
-		map[i].objp = NULL;
+	save_piece_t *sp;
+
+	for (i = 0; i < save_nlive; i++)
+		save_listed[save_live[i]] = FALSE;
+	save_nlive = 0;
+
+	for (i = 0; i < LIST_SIZE; i++) {
+		obj = &object[i];
+		sp = &save_tab[i];
+		if (obj->owner == UNOWNED || obj->hits == 0) {
+			sp->owner = UNOWNED;
+			continue;
+		}
+		list_piece (i);
+		sp->owner = obj->owner;
+		sp->type = obj->type;
+		sp->loc = obj->loc;
+		sp->func = obj->func;
+		sp->hits = obj->hits;
+		sp->moved = obj->moved;
+		sp->range = obj->range;
+		sp->count = obj->count;
+		sp->ship = obj_index (obj->ship);
+		sp->cargo = obj_index (obj->cargo);
+		sp->next = obj_index (obj->piece_link.next);
+		sp->cargo_next = obj_index (obj->cargo_link.next);
+		sp->loc_next = obj_index (obj->loc_link.next);
 	}
-	for (i = 0; i < LIST_SIZE; i++)
-	{
-		object[i].loc_link.next = NULL;
-		object[i].loc_link.prev = NULL;
-		object[i].cargo_link.next = NULL;
-		object[i].cargo_link.prev = NULL;
-		object[i].piece_link.next = NULL;
-		object[i].piece_link.prev = NULL;
-		object[i].ship = NULL;
-		object[i].cargo = NULL;
+	for (j = 0; j < NUM_OBJECTS; j++) {
+		save_heads[0][j] = obj_index (user_obj[j]);
+		save_heads[1][j] = obj_index (comp_obj[j]);
 	}
+}
+
+/* Remember the game as it is now saved. */
+
+static void
+snap_shadow (void)
+{
+	memcpy (shadow_tab, save_tab, sizeof (shadow_tab));
+	memcpy (shadow_heads, save_heads, sizeof (shadow_heads));
+	memcpy (shadow_comp, comp_map, sizeof (shadow_comp));
+	memcpy (shadow_user, user_map, sizeof (shadow_user));
+	memcpy (shadow_comp_seen, comp_seen, sizeof (shadow_comp_seen));
+	memcpy (shadow_user_seen, user_seen, sizeof (shadow_user_seen));
+	memcpy (shadow_city, city, sizeof (shadow_city));
+}
+
+static void
+put_globals (void)
+{
+	put32 (date);
+	put8 (automove);
+	put8 (resigned);
+	put8 (debug);
+	put8 (save_movie);
+	put32 (win);
+	put32 (user_score);
+	put32 (comp_score);
+}
+
+static void
+get_globals (void)
+{
+	date = gets32 ();
+	automove = get8 ();
+	resigned = get8 ();
+	debug = get8 ();
+	save_movie = get8 ();
+	win = gets32 ();
+	user_score = gets32 ();
+	comp_score = gets32 ();
+}
+
+static void
+put_heads (void)
+{
+	int i, j;
+
+	for (i = 0; i < 2; i++)
+		for (j = 0; j < NUM_OBJECTS; j++)
+			put16 (save_heads[i][j]);
+}
+
+static void
+get_heads (void)
+{
+	int i, j;
+
+	for (i = 0; i < 2; i++)
+		for (j = 0; j < NUM_OBJECTS; j++)
+			save_heads[i][j] = gets16 ();
+}
+
+static void
+put_city (const city_info_t *cityp)
+{
+	int j;
+
+	put32 (cityp->loc);
+	put8 (cityp->owner);
 	for (j = 0; j < NUM_OBJECTS; j++)
-	{
-		comp_obj[j] = NULL;
-		user_obj[j] = NULL;
-	}
-	/* put cities on map */
-	for (i = 0; i < NUM_CITY; i++)
-		map[city[i].loc].cityp = &(city[i]);
-	
-	/* put pieces in free list or on map and in object lists */
-	for (i = 0; i < LIST_SIZE; i++)
-	{
-		obj = &(object[i]);
-		if (object[i].owner == UNOWNED || object[i].hits == 0)
-		{
-			LINK (free_list, obj, piece_link);
-		} else {
-			list = LIST (object[i].owner);
-			LINK (list[object[i].type], obj, piece_link);
-			LINK (map[object[i].loc].objp, obj, loc_link);
-		}
+		put32 (cityp->func[j]);
+	put32 (cityp->work);
+	put8 (cityp->prod);
+}
+
+static void
+get_city (city_info_t *cityp)
+{
+	int j;
+
+	cityp->loc = get32 ();
+	if (cityp->loc >= MAP_SIZE) inconsistent ();
+	cityp->owner = get8 ();
+	for (j = 0; j < NUM_OBJECTS; j++)
+		cityp->func[j] = gets32 ();
+	cityp->work = gets32 ();
+	cityp->prod = get8 ();
+}
+
+static void
+put_piece (long i)
+{
+	const save_piece_t *sp = &save_tab[i];
+
+	put16 (i);
+	put8 (sp->owner);
+	put8 (sp->type);
+	put32 (sp->loc);
+	put32 (sp->func);
+	put16 (sp->hits);
+	put16 (sp->moved);
+	put16 (sp->range);
+	put16 (sp->count);
+	put16 (sp->ship);
+	put16 (sp->cargo);
+	put16 (sp->next);
+	put16 (sp->cargo_next);
+}
+
+/* read a piece record, returning its index */
+
+static long
+get_piece (void)
+{
+	long i;
+	save_piece_t *sp;
+
+	i = gets16 ();
+	if (i < 0 || i >= LIST_SIZE) inconsistent ();
+	sp = &save_tab[i];
+	sp->owner = get8 ();
+	sp->type = get8 ();
+	sp->loc = get32 ();
+	sp->func = gets32 ();
+	sp->hits = gets16 ();
+	sp->moved = gets16 ();
+	sp->range = gets16 ();
+	sp->count = gets16 ();
+	sp->ship = gets16 ();
+	sp->cargo = gets16 ();
+	sp->next = gets16 ();
+	sp->cargo_next = gets16 ();
+	if ((sp->owner != USER && sp->owner != COMP)
+	    || sp->type >= NUM_OBJECTS || sp->hits <= 0
+	    || sp->loc < 0 || sp->loc >= MAP_SIZE)
+		inconsistent ();
+	list_piece (i);
+	return (i);
+}
+
+/* note that a slot of save_tab holds a piece */
+
+static void
+list_piece (long i)
+{
+	if (!save_listed[i]) {
+		save_listed[i] = TRUE;
+		save_live[save_nlive++] = i;
 	}
-	
-	/* Embark armies and fighters. */
-	read_embark (user_obj[TRANSPORT], ARMY);
-	read_embark (user_obj[CARRIER], FIGHTER);
-	read_embark (comp_obj[TRANSPORT], ARMY);
-	read_embark (comp_obj[CARRIER], FIGHTER);
-	
-	close_file(f);
-	kill_display (); /* what we had is no longer good */
-	info("Game restored from empsave.dat.");
-	return (TRUE);
 }
-	
+
 /*
- * Embark cargo on a ship.  We loop through the list of ships.
- * We then loop through the pieces at the ship's location until
- * the ship has the same amount of cargo it previously had.
+ * Serialize a complete checkpoint of the game into save_buf.
+ * save_tab must be up to date.
  */
 
 static void
-read_embark (piece_info_t *list, piece_type_t piece_type)
+pack_game (void)
 {
-	piece_info_t *ship;
+	long i, npieces;
 	piece_info_t *obj;
-	int count;
-
-	for (ship = list; ship != NULL; ship = ship->piece_link.next) {
-		count = ship->count; /* get # of pieces we need */
-		if (count < 0) inconsistent ();
-		ship->count = 0; /* nothing on board yet */
-		for (obj = map[ship->loc].objp; obj && count;
-		    obj = obj->loc_link.next) {
-			if (obj->ship == NULL && obj->type == piece_type) {
-				embark (ship, obj);
-				count -= 1;
-			}
+
+	npieces = 0;
+	for (i = 0; i < MAP_SIZE; i++)
+		for (obj = map[i].objp; obj != NULL; obj = obj->loc_link.next)
+			npieces++;
+
+	save_len = 0;
+	for (i = 0; i < 8; i++)
+		put8 (SAVE_MAGIC[i]);
+	put16 (SAVE_VERSION);
+	put16 (MAP_WIDTH);
+	put16 (MAP_HEIGHT);
+	put16 (NUM_CITY);
+	put16 (NUM_OBJECTS);
+	put16 (LIST_SIZE);
+	put32 (generation);
+	put32 (npieces);
+
+	put_globals ();
+
+	for (i = 0; i < MAP_SIZE; i++)
+		put8 (map[i].contents);
+	for (i = 0; i < MAP_SIZE; i++)
+		put8 (comp_map[i].contents);
+	for (i = 0; i < MAP_SIZE; i++)
+		put32 (comp_seen[i]);
+	for (i = 0; i < MAP_SIZE; i++)
+		put8 (user_map[i].contents);
+	for (i = 0; i < MAP_SIZE; i++)
+		put32 (user_seen[i]);
+
+	for (i = 0; i < NUM_CITY; i++)
+		put_city (&city[i]);
+
+	put_heads ();
+
+	for (i = 0; i < MAP_SIZE; i++)
+		for (obj = map[i].objp; obj != NULL; obj = obj->loc_link.next)
+			put_piece (obj_index (obj));
+
+	assert (save_len == SAVE_MAX - (LIST_SIZE - npieces) * SAVE_PIECE);
+}
+
+/*
+ * Serialize the changes since the last save into save_buf as a
+ * journal delta.  save_tab must be up to date.
+ */
+
+#define piece_changed(a,b) ((a)->owner != (b)->owner || (a)->type != (b)->type \
+	|| (a)->loc != (b)->loc || (a)->func != (b)->func || (a)->hits != (b)->hits \
+	|| (a)->moved != (b)->moved || (a)->range != (b)->range \
+	|| (a)->count != (b)->count || (a)->ship != (b)->ship \
+	|| (a)->cargo != (b)->cargo || (a)->next != (b)->next \
+	|| (a)->cargo_next != (b)->cargo_next || (a)->loc_next != (b)->loc_next)
+
+static void
+pack_delta (void)
+{
+	long i, count, count_pos;
+	int j;
+
+	save_len = 0;
+	for (i = 0; i < 8; i++)
+		put8 (JOURNAL_MAGIC[i]);
+	put32 (generation);
+	put32 (journal_seq + 1);
+	put32 (0); /* length is filled in below */
+
+	put_globals ();
+	put_heads ();
+
+	count_pos = save_len;
+	put32 (0);
+	count = 0;
+	for (i = 0; i < MAP_SIZE; i++) {
+		if (comp_map[i].contents != shadow_comp[i].contents
+		    || comp_seen[i] != shadow_comp_seen[i]) {
+			put16 (i);
+			put8 (COMP);
+			put8 (comp_map[i].contents);
+			put32 (comp_seen[i]);
+			count++;
+		}
+		if (user_map[i].contents != shadow_user[i].contents
+		    || user_seen[i] != shadow_user_seen[i]) {
+			put16 (i);
+			put8 (USER);
+			put8 (user_map[i].contents);
+			put32 (user_seen[i]);
+			count++;
 		}
-		if (count) inconsistent ();
 	}
+	save_buf[count_pos] = count & 0xff;
+	save_buf[count_pos+1] = (count >> 8) & 0xff;
+	save_buf[count_pos+2] = (count >> 16) & 0xff;
+	save_buf[count_pos+3] = (count >> 24) & 0xff;
+
+	count_pos = save_len;
+	put16 (0);
+	count = 0;
+	for (i = 0; i < NUM_CITY; i++) {
+		if (city[i].loc == shadow_city[i].loc
+		    && city[i].owner == shadow_city[i].owner
+		    && city[i].work == shadow_city[i].work
+		    && city[i].prod == shadow_city[i].prod) {
+			for (j = 0; j < NUM_OBJECTS; j++)
+				if (city[i].func[j] != shadow_city[i].func[j])
+					break;
+			if (j == NUM_OBJECTS)
+				continue;
+		}
+		put16 (i);
+		put_city (&city[i]);
+		count++;
+	}
+	save_buf[count_pos] = count & 0xff;
+	save_buf[count_pos+1] = (count >> 8) & 0xff;
+
+	count_pos = save_len;
+	put16 (0);
+	count = 0;
+	for (i = 0; i < LIST_SIZE; i++) {
+		if (save_tab[i].owner == UNOWNED && shadow_tab[i].owner == UNOWNED)
+			continue;
+		if (save_tab[i].owner != UNOWNED
+		    && !piece_changed (&save_tab[i], &shadow_tab[i]))
+			continue;
+		if (save_tab[i].owner == UNOWNED) { /* piece was killed */
+			put8 (FALSE);
+			put16 (i);
+		}
+		else {
+			put8 (TRUE);
+			put_piece (i);
+			put16 (save_tab[i].loc_next);
+		}
+		count++;
+	}
+	save_buf[count_pos] = count & 0xff;
+	save_buf[count_pos+1] = (count >> 8) & 0xff;
+
+	i = save_len - JOURNAL_HEADER; /* fill in length */
+	save_buf[16] = i & 0xff;
+	save_buf[17] = (i >> 8) & 0xff;
+	save_buf[18] = (i >> 16) & 0xff;
+	save_buf[19] = (i >> 24) & 0xff;
+
+	put32 (checksum (save_buf, save_len));
 }
 
+/*
+ * Apply the journal delta in save_buf to the game being restored.
+ */
+
 static void
-inconsistent (void)
+apply_delta (void)
 {
-	error("empsave.dat is inconsistent.  Please remove it.\n");
-	exit (1);
+	long i, n, loc;
+	int which;
+	unsigned char contents;
+	long seen;
+
+	save_pos = JOURNAL_HEADER;
+	get_globals ();
+	get_heads ();
+
+	n = get32 ();
+	while (n-- > 0) {
+		loc = get16 ();
+		which = get8 ();
+		contents = get8 ();
+		seen = gets32 ();
+		if (loc >= MAP_SIZE) inconsistent ();
+		if (which == COMP) {
+			comp_map[loc].contents = contents;
+			comp_seen[loc] = seen;
+		}
+		else if (which == USER) {
+			user_map[loc].contents = contents;
+			user_seen[loc] = seen;
+		}
+		else inconsistent ();
+	}
+
+	n = get16 ();
+	while (n-- > 0) {
+		i = get16 ();
+		if (i >= NUM_CITY) inconsistent ();
+		get_city (&city[i]);
+	}
+
+	n = get16 ();
+	while (n-- > 0) {
+		if (get8 ()) { /* piece is alive */
+			i = get_piece ();
+			save_tab[i].loc_next = gets16 ();
+		}
+		else {
+			i = get16 ();
+			if (i >= LIST_SIZE) inconsistent ();
+			save_tab[i].owner = UNOWNED;
+		}
+	}
+	if (save_pos != save_len - 4) inconsistent ();
 }
 
 /*
- * Write a buffer to a file.  If we cannot write everything, return FALSE.
- * Also, tell the user why the write did not work if it didn't.
+ * Saving is done in the background so that the game does not stop
+ * while the save file is compressed and written.  The game is packed
+ * into save_buf in the foreground, then a child process writes the
+ * buffer to a temporary file and renames it over empsave.dat, so that
+ * a crash part way through never leaves a damaged save behind.  Journal
+ * deltas are appended to empsave.log the same way.  The child reports
+ * how it fared in its exit status.  Only one save is in progress at a
+ * time.
  */
 
-static int
-xwrite (file f, void *buf, int size)
+#define SAVE_OK		0
+#define SAVE_EOPEN	1	/* cannot create temporary file */
+#define SAVE_EWRITE	2	/* write failed */
+#define SAVE_ERENAME	3	/* cannot rename temporary file */
+
+static pid_t save_pid = -1; /* process writing the save, if any */
+static int save_delta; /* TRUE if save_buf holds a journal delta */
+
+void
+save_game (void)
 {
-	int bytes;
+	save_wait (); /* finish any save in progress */
+	snap_pieces ();
 
-	bytes = write_file(f, buf, size);
-	if (bytes == -1) {
-		error ("Write to save file failed");
-		return (FALSE);
+	if (generation == 0) /* make generations differ between games */
+		generation = (unsigned long) time (NULL);
+
+	save_delta = journal_interval > 0 && journal_ok
+		&& journal_seq + 1 < (unsigned long) journal_interval;
+
+	if (save_delta) {
+		pack_delta ();
+		journal_seq++;
 	}
-	if (bytes != size) {
-		error ("Cannot complete write to save file.\n");
-		return (FALSE);
+	else {
+		generation++;
+		pack_game ();
+		journal_seq = 0;
 	}
-	return (TRUE);
+	snap_shadow ();
+	journal_ok = TRUE;
+
+	save_pid = fork ();
+	if (save_pid == 0) /* child */
+		_exit (write_save ());
+
+	if (save_pid == -1) /* no child; do it ourselves */
+		save_report (write_save ());
 }
 
 /*
- * Read a buffer from a file.  If the read fails, we tell the user why
- * and return FALSE.
+ * Write save_buf to disk.  A checkpoint goes to a temporary file which
+ * is flushed to disk and then moved into place, after which the old
+ * journal is discarded.  A delta is appended to the journal.
  */
 
 static int
-xread (file f, void *buf, int size)
+write_save (void)
 {
-	int bytes;
+	int fd;
+	file f;
 
-	bytes = read_file (f, buf, size);
-	if (bytes == 0) {
-		error ("Read from save file failed");
-		return (FALSE);
+	if (save_delta)
+		fd = open ("empsave.log", O_WRONLY | O_CREAT | O_APPEND, 0666);
+	else
+		fd = open ("empsave.tmp", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd == -1)
+		return (SAVE_EOPEN);
+
+	f = dopen_file (dup (fd), "w");
+	if (f == NULL) {
+		close (fd);
+		return (SAVE_EOPEN);
 	}
-	if (bytes != size) {
-		error ("Saved file is too short.\n");
-		return (FALSE);
+	if (write_file (f, save_buf, save_len) != save_len) {
+		close_file (f);
+		close (fd);
+		return (SAVE_EWRITE);
 	}
-	return (TRUE);
+	if (close_file (f) != 0 || fsync (fd) == -1) {
+		close (fd);
+		return (SAVE_EWRITE);
+	}
+	close (fd);
+
+	if (save_delta)
+		return (SAVE_OK);
+
+	if (rename ("empsave.tmp", "empsave.dat") == -1)
+		return (SAVE_ERENAME);
+	(void) unlink ("empsave.log"); /* deltas of the old checkpoint */
+	return (SAVE_OK);
 }
 
 /*
- * Save a movie screen.  For each cell on the board, we write out
- * the character that would appear on either the user's or the
- * computer's screen.  This information is appended to 'empmovie.dat'.
+ * Tell the user how a save went.  If it failed, the next save must
+ * be a full checkpoint since the journal no longer matches our shadow.
  */
 
-static char mapbuf[MAP_SIZE];
+static void
+save_report (int status)
+{
+	if (status != SAVE_OK)
+		journal_ok = FALSE;
+
+	switch (status) {
+	case SAVE_OK:
+		info ("Game saved.");
+		break;
+	case SAVE_EOPEN:
+		error ("Cannot save empsave.dat");
+		break;
+	case SAVE_ERENAME:
+		error ("Cannot rename empsave.tmp to empsave.dat");
+		break;
+	default:
+		error ("Write to save file failed");
+		break;
+	}
+}
+
+/* Check whether a background save has finished, without waiting. */
 
 void
-save_movie_screen (void)
+save_poll (void)
 {
-	file f; /* file to save movie in */
-	long i;
-	piece_info_t *p;
+	int status;
 
-	f = open_file("empmovie.dat", "a"); /* open for append */
-	if (f == NULL)
-	{
-		error ("Cannot open empmovie.dat");
+	if (save_pid <= 0)
+		return;
+	if (waitpid (save_pid, &status, WNOHANG) != save_pid)
 		return;
-	}
 
-	for (i = 0; i < MAP_SIZE; i++)
-	{
-		if (map[i].cityp)
-			mapbuf[i] = city_char[map[i].cityp->owner];
-		else
-		{
-			p = find_obj_at_loc (i);
-			
-			if (!p)
-				mapbuf[i] = map[i].contents;
-			else if (p->owner == USER)
-				mapbuf[i] = piece_attr[p->type].sname;
-			else
-				mapbuf[i] = tolower(piece_attr[p->type].sname);
+	save_pid = -1;
+	save_report (WIFEXITED (status) ? WEXITSTATUS (status) : SAVE_EWRITE);
+}
+
+/* Wait for a background save to finish. */
+
+void
+save_wait (void)
+{
+	int status;
+
+	if (save_pid <= 0)
+		return;
+	while (waitpid (save_pid, &status, 0) == -1)
+		if (errno != EINTR) {
+			save_pid = -1;
+			return;
 		}
-	}
-	wbuf (mapbuf);
-	close_file(f);
+
+	save_pid = -1;
+	save_report (WIFEXITED (status) ? WEXITSTATUS (status) : SAVE_EWRITE);
 }
 
 /*
- * Replay a movie.  We read each buffer from the file and
- * print it using a zoomed display.
+ * Read the journal and apply each delta which follows the checkpoint
+ * we restored.  Return the number of deltas applied.  '*clean' is set
+ * to TRUE if we stopped at the end of the journal, or FALSE if we
+ * stopped at a damaged delta or one which doesn't follow the last, in
+ * which case anything we append would never be replayed.
  */
 
-void
-replay_movie (void)
+static unsigned long
+replay_journal (int *clean)
 {
-	file f; /* file to read movie from */
-	int round;
-	
-	f = open_file("empmovie.dat", "r"); /* open for input */
+	file f;
+	long len;
+	unsigned long seq;
+
+	*clean = TRUE;
+	f = open_file ("empsave.log", "r");
 	if (f == NULL)
-	{
-		error ("Cannot open empmovie.dat");
-		return;
+		return (0);
+
+	*clean = FALSE;
+	for (seq = 0; ; seq++) {
+		len = read_file (f, save_buf, JOURNAL_HEADER);
+		if (len == 0)
+			*clean = TRUE; /* end of journal */
+		if (len != JOURNAL_HEADER)
+			break;
+		save_len = JOURNAL_HEADER;
+		save_pos = 8;
+		if (memcmp (save_buf, JOURNAL_MAGIC, 8) != 0
+		    || get32 () != generation || get32 () != seq + 1)
+			break;
+		len = get32 () + 4; /* data and checksum */
+		if (len > SAVE_BUF_MAX - JOURNAL_HEADER
+		    || read_file (f, save_buf + JOURNAL_HEADER, len) != len)
+			break;
+		save_len += len;
+		save_pos = save_len - 4;
+		if (get32 () != checksum (save_buf, save_len - 4))
+			break;
+		apply_delta ();
 	}
-	round = 0;
+	close_file (f);
+	return (seq);
+}
 
-	term_clear();
+/*
+ * Build the live pieces from save_tab and save_heads.  We link each
+ * list in the saved order, checking that the lists make sense.
+ */
 
-	while (1)
-	{
-		if (!xread (f, mapbuf, sizeof(mapbuf)))
-			break;
+static void
+relink (int head, int owner, int type)
+{
+	int i, prev, n;
+	piece_info_t *obj;
 
-		round += 1;
-		
-		stat_display(mapbuf, round);
-	
-		print_movie_screen(mapbuf);
+	prev = -1;
+	for (i = head, n = 0; i != -1; prev = i, i = save_tab[i].next) {
+		if (i < 0 || i >= LIST_SIZE || ++n > LIST_SIZE)
+			inconsistent ();
+		if (save_tab[i].owner != owner || save_tab[i].type != type)
+			inconsistent ();
+		obj = &object[i];
+		obj->piece_link.prev = prev == -1 ? NULL : &object[prev];
+		obj->piece_link.next = save_tab[i].next == -1 ? NULL : &object[save_tab[i].next];
 	}
+}
 
-	close_file(f);
+/* convert a saved index to a pointer to a live piece */
+
+static piece_info_t *
+live_obj (int i)
+{
+	if (i == -1)
+		return (NULL);
+	if (i < 0 || i >= LIST_SIZE || save_tab[i].owner == UNOWNED)
+		inconsistent ();
+	return (&object[i]);
+}
+
+static int
+index_cmp (const void *a, const void *b)
+{
+	return (*(const int *)a - *(const int *)b);
+}
+
+static void
+unpack_pieces (void)
+{
+	long i, k, n;
+	int j;
+	piece_info_t *obj, *prev;
+	save_piece_t *sp;
+	static unsigned char is_next[LIST_SIZE];
+
+	/* drop the pieces killed by the journal, and sort the rest */
+	n = 0;
+	for (k = 0; k < save_nlive; k++) {
+		i = save_live[k];
+		if (save_tab[i].owner == UNOWNED)
+			save_listed[i] = FALSE;
+		else save_live[n++] = i;
+	}
+	save_nlive = n;
+	qsort (save_live, save_nlive, sizeof (save_live[0]), index_cmp);
+
+	for (k = 0; k < save_nlive; k++)
+		is_next[save_live[k]] = FALSE;
+
+	for (k = 0; k < save_nlive; k++) {
+		i = save_live[k];
+		sp = &save_tab[i];
+		obj = &object[i];
+		obj->owner = sp->owner;
+		obj->type = sp->type;
+		obj->loc = sp->loc;
+		obj->func = sp->func;
+		obj->hits = sp->hits;
+		obj->moved = sp->moved;
+		obj->range = sp->range;
+		obj->count = sp->count;
+		obj->ship = live_obj (sp->ship);
+		obj->cargo = live_obj (sp->cargo);
+		obj->piece_link.prev = NULL;
+		obj->piece_link.next = NULL;
+		obj->loc_link.next = NULL;
+		obj->cargo_link.prev = NULL;
+		obj->cargo_link.next = live_obj (sp->cargo_next);
+		if (live_obj (sp->loc_next) != NULL) {
+			if (save_tab[sp->loc_next].loc != sp->loc || is_next[sp->loc_next])
+				inconsistent ();
+			is_next[sp->loc_next] = TRUE;
+		}
+	}
+	for (k = 0; k < save_nlive; k++) {
+		obj = &object[save_live[k]];
+		if (obj->cargo_link.next)
+			obj->cargo_link.next->cargo_link.prev = obj;
+	}
+
+	for (j = 0; j < NUM_OBJECTS; j++) {
+		user_obj[j] = live_obj (save_heads[0][j]);
+		relink (save_heads[0][j], USER, j);
+		comp_obj[j] = live_obj (save_heads[1][j]);
+		relink (save_heads[1][j], COMP, j);
+	}
+
+	/* put pieces on the map, keeping the saved order at each location */
+	for (k = 0; k < save_nlive; k++) {
+		i = save_live[k];
+		if (is_next[i])
+			continue;
+		if (map[save_tab[i].loc].objp != NULL)
+			inconsistent ();
+		prev = NULL;
+		for (j = i, n = 0; j != -1; j = save_tab[j].loc_next) {
+			if (++n > LIST_SIZE) inconsistent ();
+			obj = &object[j];
+			obj->loc_link.prev = prev;
+			if (prev) prev->loc_link.next = obj;
+			else map[obj->loc].objp = obj;
+			prev = obj;
+		}
+	}
+
+	/* the gaps between the pieces go in the free list */
+	free_list = NULL;
+	i = 0;
+	for (k = 0; k <= save_nlive; k++) {
+		n = k < save_nlive ? save_live[k] : LIST_SIZE;
+		for (; i < n; i++) {
+			obj = &(object[i]);
+			obj->owner = UNOWNED;
+			obj->hits = 0;
+			LINK (free_list, obj, piece_link);
+		}
+		i = n + 1;
+	}
 }
 
 /*
- * Display statistics about the game.  At the top of the screen we
- * print:
- * 
- * nn O  nn A  nn F  nn P  nn D  nn S  nn T  nn C  nn B  nn Z  xxxxx
- * nn X  nn a  nn f  nn p  nn d  nn s  nn t  nn c  nn b  nn z  xxxxx
- * 
- * There may be objects in cities and boats that aren't displayed.
- * The "xxxxx" field is the cumulative cost of building the hardware.
+ * Recover a saved game from emp_save.dat.
+ * We return TRUE if we succeed, otherwise FALSE.
  */
 
-/* in declared order, with city first */
-static const char *pieces = "OAFPDSTCBZXafpdstcbz";
-
-static void
-stat_display (char *mbuf, int round)
+int
+restore_game (void)
 {
-	long i;
-	int counts[2*NUM_OBJECTS+2];
-	int user_cost, comp_cost;
-	char *p;
-	char buf1[STRSIZE], buf2[STRSIZE];
-	
-	memset(counts, 0, sizeof(counts));
-	
-	for (i = 0; i < MAP_SIZE; i++)
-	{
-		p = strchr (pieces, mbuf[i]);
-		if (p) counts[p-pieces] += 1;
+	file f; /* file to save game in */
+	long i, j, npieces, prev;
+	int bytes;
+	int clean; /* TRUE if the whole journal was replayed */
+
+	save_wait (); /* make sure the save file is complete */
+
+	f = open_file("empsave.dat", "r"); /* open for input */
+	if (f == NULL) {
+		error("Cannot open empsave.dat");
+		return (FALSE);
 	}
+	save_len = 0;
+	while (save_len < SAVE_MAX
+	    && (bytes = read_file (f, save_buf + save_len, SAVE_MAX - save_len)) > 0)
+		save_len += bytes;
+	close_file(f);
 
-	user_cost = 0;
-	for (i = 1; i <= NUM_OBJECTS; i++)
-		user_cost += counts[i] * piece_attr[i-1].build_time;
-		
-	comp_cost = 0;
-	for (i = NUM_OBJECTS+2; i <= 2*NUM_OBJECTS+1; i++)
-		comp_cost += counts[i] * piece_attr[i-NUM_OBJECTS-2].build_time;
-		
-	for (i = FIRST_OBJECT; i < NUM_OBJECTS+1; i++)
-	{
-		snprintf(buf1 + (i*6), STRSIZE - (i*6), "%2d %c  ", counts[i], pieces[i]);
-		snprintf(buf2 + (i*6), STRSIZE - (i*6), "%2d %c  ", counts[i+NUM_OBJECTS+1], pieces[i+NUM_OBJECTS+1]);
+	save_pos = 0;
+	if (save_len < SAVE_HEADER
+	    || memcmp (save_buf, SAVE_MAGIC, 8) != 0) {
+		error ("empsave.dat is not a saved game.");
+		return (FALSE);
+	}
+	save_pos = 8;
+	if (get16 () != SAVE_VERSION) {
+		error ("empsave.dat was saved by a different version of empire.");
+		return (FALSE);
+	}
+	if (get16 () != MAP_WIDTH || get16 () != MAP_HEIGHT
+	    || get16 () != NUM_CITY || get16 () != NUM_OBJECTS
+	    || get16 () != LIST_SIZE) {
+		error ("empsave.dat was saved with a different map size.");
+		return (FALSE);
+	}
+	generation = get32 ();
+	npieces = get32 ();
+	if (npieces > LIST_SIZE
+	    || save_len != SAVE_MAX - (LIST_SIZE - npieces) * SAVE_PIECE) {
+		error ("Saved file is the wrong length.");
+		return (FALSE);
 	}
 
-	snprintf(buf1 + (i*6), STRSIZE - (i*6), "%5d", user_cost);
-	snprintf(buf2 + (i*6), STRSIZE - (i*6), "%5d", comp_cost);
+	get_globals ();
 
-	info(buf1);
-	info(buf2);
-	info("");
+	for (i = 0; i < MAP_SIZE; i++) {
+		map[i].contents = get8 ();
+		map[i].on_board = !(loc_col (i) == 0 || loc_col (i) == MAP_WIDTH-1
+				 || loc_row (i) == 0 || loc_row (i) == MAP_HEIGHT-1);
+		map[i].cityp = NULL;
+		map[i].objp = NULL;
+	}
+	for (i = 0; i < MAP_SIZE; i++)
+		comp_map[i].contents = get8 ();
+	for (i = 0; i < MAP_SIZE; i++)
+		comp_seen[i] = gets32 ();
+	for (i = 0; i < MAP_SIZE; i++)
+		user_map[i].contents = get8 ();
+	for (i = 0; i < MAP_SIZE; i++)
+		user_seen[i] = gets32 ();
+
+	for (i = 0; i < NUM_CITY; i++)
+		get_city (&city[i]);
 
-	prompt("Round %3d", (round + 1) / 2);
+	get_heads ();
+
+	for (i = 0; i < save_nlive; i++) { /* forget the pieces we had */
+		save_tab[save_live[i]].owner = UNOWNED;
+		save_listed[save_live[i]] = FALSE;
+	}
+	save_nlive = 0;
+
+	/* records for the same location are adjacent, in list order */
+	prev = -1;
+	for (i = 0; i < npieces; i++) {
+		j = get_piece ();
+		save_tab[j].loc_next = -1;
+		if (prev != -1 && save_tab[prev].loc == save_tab[j].loc)
+			save_tab[prev].loc_next = j;
+		prev = j;
+	}
+
+	journal_seq = replay_journal (&clean);
+
+	for (i = 0; i < NUM_CITY; i++) /* put cities on map */
+		map[city[i].loc].cityp = &(city[i]);
+	city_changed ();
+	comp_map_reloaded ();
+	unpack_pieces ();
+
+	snap_shadow ();
+	journal_ok = clean; /* else next save must be a checkpoint */
+
+	kill_display (); /* what we had is no longer good */
+	info("Game restored from empsave.dat.");
+	return (TRUE);
+}
+	
+static void
+inconsistent (void)
+{
+	error("empsave.dat is inconsistent.  Please remove it.\n");
+	exit (1);
 }
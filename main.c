@@ -20,6 +20,20 @@
  * 	       
  *    -S save_interval: sets turn interval between saves.
  * 	       default is 10
+ *
+ *    -j interval: journal saves.  Only every interval'th save writes
+ * 	       the whole game; the others append the changes since the
+ * 	       last save to a log.  default is 0 (no journal).
+ *
+ *    -f fps: limit screen updates in automove mode to fps per second.
+ * 	       0 means don't update the map at all until automove ends.
+ * 	       default is to show every change.
+ *
+ *    -m: print the statistics recorded with the movie in empmovie.sta
+ * 	       and exit.
+ *
+ *    -b ms: limit the time the computer spends moving its pieces each
+ * 	       turn to about ms milliseconds.  default is 0 (no limit).
  */
 
 #include <stdio.h>
@@ -28,19 +42,22 @@
 #include "empire.h"
 #include "extern.h"
 
-#define OPTFLAGS "w:s:d:S:tVC"
+#define OPTFLAGS "w:s:d:S:f:j:b:mtVC"
 
 int
 main (int argc, char *argv[])
 {
 	int c;
 	int errflg = 0;
-	int wflg, sflg, Sflg;
+	int wflg, sflg, Sflg, fflg, jflg, bflg;
 	int land;
 	
 	wflg = 70; /* set defaults */
 	sflg = 5;
 	Sflg = 10;
+	fflg = -1;
+	jflg = 0;
+	bflg = 0;
 
 	/* extract command line options */
 
@@ -70,6 +87,38 @@ main (int argc, char *argv[])
 				exit (1);
 			}
 			break;
+		case 'f':
+			fflg = atoi (optarg);
+			if (fflg < 0)
+			{
+				fprintf(stderr, "empire: -f argument must be greater than or equal to zero.\n");
+				exit (1);
+			}
+			break;
+		case 'j':
+			jflg = atoi (optarg);
+			if (jflg < 0)
+			{
+				fprintf(stderr, "empire: -j argument must be greater than or equal to zero.\n");
+				exit (1);
+			}
+			break;
+		case 'b':
+			bflg = atoi (optarg);
+			if (bflg < 0)
+			{
+				fprintf(stderr, "empire: -b argument must be greater than or equal to zero.\n");
+				exit (1);
+			}
+			break;
+		case 'm':
+			if (!movie_stats ())
+			{
+				fprintf(stderr, "empire: cannot read empmovie.sta.\n");
+				exit (1);
+			}
+			exit (0);
+			break;
 		case 't':
 			traditional = 1;
 			break;
@@ -88,13 +137,16 @@ main (int argc, char *argv[])
 
 	if (errflg || ((argc - optind) != 0))
 	{
-		fprintf(stderr, "empire: usage: empire [-w water] [-s smooth] [-d delay] [-S save_interval] [-V]\n");
+		fprintf(stderr, "empire: usage: empire [-w water] [-s smooth] [-d delay] [-S save_interval] [-j interval] [-f fps] [-b ms] [-m] [-V]\n");
 		exit (1);
 	}
 
 	SMOOTH = sflg;
 	WATER_RATIO = wflg;
 	save_interval = Sflg;
+	frame_rate = fflg;
+	journal_interval = jflg;
+	comp_budget = bflg;
 
 	/* compute min distance between cities */
 	land = MAP_SIZE * (100 - WATER_RATIO) / 100;	/* available land		*/
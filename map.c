@@ -14,15 +14,27 @@
  * real_maps, path_maps, and cont_maps.
  */
 
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
 #include <string.h>
 #include "empire.h"
 #include "extern.h"
 
+#define CONT_WORDS ((MAP_WIDTH+63)/64)	/* words in a row of a bit map */
+
 static void	add_cell (path_map_t *, long, perimeter_t *, int, int, int);
+static void	cont_spread (uint64_t (*)[CONT_WORDS], uint64_t (*)[CONT_WORDS], int, int);
+static void	cont_terrain (const view_map_t *, int, char);
 static void	expand_perimeter (path_map_t *, const view_map_t *, const move_info_t *, perimeter_t *,
 		int, int, int, int, perimeter_t *, perimeter_t *);
 static void	expand_prune (view_map_t *, path_map_t *, long, int, perimeter_t *, int *);
-static int	objective_cost (const view_map_t *, const move_info_t *, long, int);
+static int	objective_cost (const view_map_t *, const int *, long, int);
+int	*cmap_get (void);
+void	cmap_put (int *);
+path_map_t	*pmap_get (void);
+void	pmap_put (path_map_t *);
+static void	prune_explore_locs (view_map_t *, path_map_t *);
 int     rmap_shore (long);
 static void	start_perimeter (path_map_t *, perimeter_t *, long, int);
 static int	terrain_type (const path_map_t *, const view_map_t *, const move_info_t *, long, long);
@@ -31,6 +43,7 @@ void	vmap_cont (int *, const view_map_t *, long, char);
 scan_counts_t	vmap_cont_scan (int *, const view_map_t *);
 static int	vmap_count_adjacent (const view_map_t *, long, const char *);
 static int	vmap_count_path (path_map_t *, long);
+static const int	*weight_table (const move_info_t *);
 long    vmap_find_aobj (path_map_t[], const view_map_t *, long, const move_info_t *);
 long    vmap_find_dest (path_map_t[], view_map_t[], long, long, int, int);
 long    vmap_find_dir (path_map_t[], const view_map_t *, long, const char *, const char *);
@@ -58,6 +71,49 @@ static perimeter_t p4;
 static int best_cost; /* cost and location of best objective */
 static long best_loc;
 
+/*
+ * Path maps and continent maps are too big to put on the stack, so
+ * searches borrow them from these pools and give them back when done.
+ * Maps must be given back in the reverse of the order they were taken.
+ */
+
+#define NUM_WORK 4	/* maps of each kind that may be in use at once */
+
+static path_map_t pmap_work[NUM_WORK][MAP_SIZE];
+static int pmap_used;
+static int cmap_work[NUM_WORK][MAP_SIZE];
+static int cmap_used;
+
+path_map_t *
+pmap_get (void)
+{
+	if (pmap_used == NUM_WORK)
+		panic("out of path maps");
+	return pmap_work[pmap_used++];
+}
+
+void
+pmap_put (path_map_t *pmap)
+{
+	assert (pmap_used > 0 && pmap == pmap_work[pmap_used-1]);
+	pmap_used -= 1;
+}
+
+int *
+cmap_get (void)
+{
+	if (cmap_used == NUM_WORK)
+		panic("out of continent maps");
+	return cmap_work[cmap_used++];
+}
+
+void
+cmap_put (int *cont_map)
+{
+	assert (cmap_used > 0 && cont_map == cmap_work[cmap_used-1]);
+	cmap_used -= 1;
+}
+
 /*
  * Map out a continent.  We are given a location on the continent.
  * We mark each square that is part of the continent and unexplored
@@ -77,45 +133,144 @@ vmap_cont (int *cont_map, const view_map_t *vmap, long loc, char bad_terrain)
  * Mark all squares of a continent and the squares that are adjacent
  * to the continent which are on the board.  Our passed location is
  * known to be either on the continent or adjacent to the continent.
+ *
+ * We keep the squares as bit maps, one bit per square and a few words
+ * per row, so that we can grow the continent by a ring of squares with
+ * a handful of operations on each row.  Rows of the terrain bit maps
+ * are filled in when the continent first reaches them.
  */
 
+static uint64_t cont_good[MAP_HEIGHT][CONT_WORDS]; /* squares we may cross */
+static uint64_t cont_unexp[MAP_HEIGHT][CONT_WORDS]; /* unexplored squares */
+static char cont_row_done[MAP_HEIGHT]; /* TRUE if row of above is filled in */
+static uint64_t cont_in[MAP_HEIGHT][CONT_WORDS]; /* squares on the continent */
+static uint64_t cont_ring[MAP_HEIGHT][CONT_WORDS]; /* squares added last */
+static uint64_t cont_near[MAP_HEIGHT][CONT_WORDS]; /* squares next to them */
+
+#define BIT(col) ((uint64_t)1 << ((col) % 64))
+
 void
 vmap_mark_up_cont (int *cont_map, const view_map_t *vmap, long loc, char bad_terrain)
 {
-	int i, j;
-	long new_loc;
+	int row, col, w;
+	int top, bottom, new_top, new_bottom; /* rows holding the last ring */
+	int in_top, in_bottom; /* rows holding the continent */
+
+	memset (cont_row_done, 0, sizeof (cont_row_done));
+	memset (cont_in, 0, sizeof (cont_in));
+
+	row = loc_row (loc);
+	col = loc_col (loc);
+	memset (cont_ring[row], 0, sizeof (cont_ring[row]));
+	cont_in[row][col/64] = cont_ring[row][col/64] = BIT (col);
+	top = bottom = in_top = in_bottom = row;
+
+	while (top <= bottom) { /* add squares next to the last ring */
+		cont_spread (cont_ring, cont_near, top, bottom);
+		if (top > 0) top -= 1;
+		if (bottom < MAP_HEIGHT-1) bottom += 1;
+		new_top = MAP_HEIGHT;
+		new_bottom = -1;
+
+		for (row = top; row <= bottom; row++) {
+			if (!cont_row_done[row])
+				cont_terrain (vmap, row, bad_terrain);
+
+			for (w = 0; w < CONT_WORDS; w++) {
+				cont_ring[row][w] = cont_near[row][w] & cont_good[row][w] & ~cont_in[row][w];
+				cont_in[row][w] |= cont_ring[row][w];
+				if (cont_ring[row][w]) {
+					if (row < new_top) new_top = row;
+					new_bottom = row;
+				}
+			}
+		}
+		top = new_top;
+		bottom = new_bottom;
+		if (top < in_top) in_top = top;
+		if (bottom > in_bottom) in_bottom = bottom;
+	}
+
+	/* add unexplored territory next to the continent */
+	cont_spread (cont_in, cont_near, in_top, in_bottom);
+	if (in_top > 0) in_top -= 1;
+	if (in_bottom < MAP_HEIGHT-1) in_bottom += 1;
+
+	for (row = in_top; row <= in_bottom; row++) {
+		if (!cont_row_done[row])
+			cont_terrain (vmap, row, bad_terrain);
+
+		for (w = 0; w < CONT_WORDS; w++) {
+			cont_in[row][w] |= cont_near[row][w] & cont_unexp[row][w];
+			if (cont_in[row][w])
+			for (col = w*64; col < MAP_WIDTH && col < w*64+64; col++)
+				if (cont_in[row][w] & BIT (col))
+					cont_map[row_col_loc (row, col)] = 1;
+		}
+	}
+}
+
+/* Fill in a row of the terrain bit maps. */
+
+static void
+cont_terrain (const view_map_t *vmap, int row, char bad_terrain)
+{
+	int col;
+	long i;
 	char this_terrain;
-	perimeter_t *from, *to;
 
-	from = &p1;
-	to = &p2;
-	
-	from->len = 1; /* init perimeter */
-	from->list[0] = loc;
-	cont_map[loc] = 1; /* loc is on continent */
-	
-	while (from->len) {
-		to->len = 0; /* nothing in new perimeter yet */
+	cont_row_done[row] = TRUE;
+
+	memset (cont_good[row], 0, sizeof (cont_good[row]));
+	memset (cont_unexp[row], 0, sizeof (cont_unexp[row]));
+
+	if (row == 0 || row == MAP_HEIGHT-1) return; /* off the board */
+
+	for (col = 1; col < MAP_WIDTH-1; col++) {
+		i = row_col_loc (row, col);
 		
-		for (i = 0; i < from->len; i++) /* expand perimeter */
-		FOR_ADJ_ON(from->list[i], new_loc, j)
-		if (!cont_map[new_loc]) {
-			/* mark, but don't expand, unexplored territory */
-			if (vmap[new_loc].contents == ' ')
-				cont_map[new_loc] = 1;
-			else {
-				if (vmap[new_loc].contents == '+') this_terrain = '+';
-				else if (vmap[new_loc].contents == '.') this_terrain = '.';
-				else this_terrain = map[new_loc].contents;
-				
-				if (this_terrain != bad_terrain) { /* on continent? */
-					cont_map[new_loc] = 1;
-					to->list[to->len] = new_loc;
-					to->len += 1;
-				}
-			}
+		if (vmap[i].contents == ' ')
+			cont_unexp[row][col/64] |= BIT (col);
+		else {
+			if (vmap[i].contents == '+') this_terrain = '+';
+			else if (vmap[i].contents == '.') this_terrain = '.';
+			else this_terrain = map[i].contents;
+
+			if (this_terrain != bad_terrain)
+				cont_good[row][col/64] |= BIT (col);
 		}
-		SWAP (from, to);
+	}
+}
+
+/*
+ * Find the squares which are next to any square in rows 'top' through
+ * 'bottom' of a bit map.  Only the rows from 'top'-1 to 'bottom'+1 of
+ * the result are set.
+ */
+
+static void
+cont_spread (uint64_t (*from)[CONT_WORDS], uint64_t (*to)[CONT_WORDS], int top, int bottom)
+{
+	uint64_t across[MAP_HEIGHT][CONT_WORDS];
+	int row, w;
+
+	for (row = top; row <= bottom; row++)
+	for (w = 0; w < CONT_WORDS; w++) {
+		across[row][w] = from[row][w] | from[row][w] << 1 | from[row][w] >> 1;
+		if (w > 0)
+			across[row][w] |= from[row][w-1] >> 63;
+		if (w < CONT_WORDS-1)
+			across[row][w] |= from[row][w+1] << 63;
+	}
+	for (row = top > 0 ? top-1 : 0; row <= bottom+1 && row < MAP_HEIGHT; row++)
+	for (w = 0; w < CONT_WORDS; w++) {
+		to[row][w] = 0;
+		if (row-1 >= top)
+			to[row][w] |= across[row-1][w];
+		if (row >= top && row <= bottom)
+			to[row][w] |= across[row][w];
+		if (row+1 <= bottom)
+			to[row][w] |= across[row+1][w];
 	}
 }
 
@@ -123,55 +278,67 @@ vmap_mark_up_cont (int *cont_map, const view_map_t *vmap, long loc, char bad_ter
  * Scan a continent recording items of interest on the continent.
  * 
  * This could be done as we mark up the continent.
+ *
+ * We first count the cells of the continent with each kind of contents,
+ * and the cities under each kind of contents by owner, which is a simple
+ * loop over the whole map, and then add up the counts we are interested
+ * in.
  */
 
-#define COUNT(c,item) case c: item += 1; break
+#define COUNT(c,item) case c: item += n; break
 
 scan_counts_t
 vmap_cont_scan (int *cont_map, const view_map_t *vmap)
 {
 	scan_counts_t counts;
-	long i;
+	long hist[UCHAR_MAX+1]; /* cells of continent with each contents */
+	long under[UCHAR_MAX+1][COMP+1]; /* cities under each contents */
+	long i, n;
+	int c;
 
 	memset(&counts, 0, sizeof(scan_counts_t));
+	memset(hist, 0, sizeof(hist));
+	memset(under, 0, sizeof(under));
 	
 	for (i = 0; i < MAP_SIZE; i++) {
-		if (cont_map[i])
-		{ /* cell on continent? */
-			counts.size += 1;
-			
-			switch (vmap[i].contents) {
-			COUNT (' ', counts.unexplored);
-			COUNT ('O', counts.user_cities);
-			COUNT ('A', counts.user_objects[ARMY]);
-			COUNT ('F', counts.user_objects[FIGHTER]);
-			COUNT ('P', counts.user_objects[PATROL]);
-			COUNT ('D', counts.user_objects[DESTROYER]);
-			COUNT ('S', counts.user_objects[SUBMARINE]);
-			COUNT ('T', counts.user_objects[TRANSPORT]);
-			COUNT ('C', counts.user_objects[CARRIER]);
-			COUNT ('B', counts.user_objects[BATTLESHIP]);
-			COUNT ('X', counts.comp_cities);
-			COUNT ('a', counts.comp_objects[ARMY]);
-			COUNT ('f', counts.comp_objects[FIGHTER]);
-			COUNT ('p', counts.comp_objects[PATROL]);
-			COUNT ('d', counts.comp_objects[DESTROYER]);
-			COUNT ('s', counts.comp_objects[SUBMARINE]);
-			COUNT ('t', counts.comp_objects[TRANSPORT]);
-			COUNT ('c', counts.comp_objects[CARRIER]);
-			COUNT ('b', counts.comp_objects[BATTLESHIP]);
-			COUNT ('*', counts.unowned_cities);
-			case '+': break;
-			case '.': break;
-			default: /* check for city underneath */
-				if (map[i].contents == '*') {
-					switch (map[i].cityp->owner) {
-					COUNT (USER, counts.user_cities);
-					COUNT (COMP, counts.comp_cities);
-					COUNT (UNOWNED, counts.unowned_cities);
-					}
-				}
-			}
+		if (cont_map[i] == 0) continue;
+		hist[vmap[i].contents] += 1;
+		if (map[i].contents == '*')
+			under[vmap[i].contents][map[i].cityp->owner] += 1;
+	}
+
+	for (c = 0; c <= UCHAR_MAX; c++) {
+		n = hist[c];
+		if (n == 0) continue;
+		counts.size += n;
+
+		switch (c) {
+		COUNT (' ', counts.unexplored);
+		COUNT ('O', counts.user_cities);
+		COUNT ('A', counts.user_objects[ARMY]);
+		COUNT ('F', counts.user_objects[FIGHTER]);
+		COUNT ('P', counts.user_objects[PATROL]);
+		COUNT ('D', counts.user_objects[DESTROYER]);
+		COUNT ('S', counts.user_objects[SUBMARINE]);
+		COUNT ('T', counts.user_objects[TRANSPORT]);
+		COUNT ('C', counts.user_objects[CARRIER]);
+		COUNT ('B', counts.user_objects[BATTLESHIP]);
+		COUNT ('X', counts.comp_cities);
+		COUNT ('a', counts.comp_objects[ARMY]);
+		COUNT ('f', counts.comp_objects[FIGHTER]);
+		COUNT ('p', counts.comp_objects[PATROL]);
+		COUNT ('d', counts.comp_objects[DESTROYER]);
+		COUNT ('s', counts.comp_objects[SUBMARINE]);
+		COUNT ('t', counts.comp_objects[TRANSPORT]);
+		COUNT ('c', counts.comp_objects[CARRIER]);
+		COUNT ('b', counts.comp_objects[BATTLESHIP]);
+		COUNT ('*', counts.unowned_cities);
+		case '+': break;
+		case '.': break;
+		default: /* check for city underneath */
+			counts.user_cities += under[c][USER];
+			counts.comp_cities += under[c][COMP];
+			counts.unowned_cities += under[c][UNOWNED];
 		}
 	}
 	return counts;
@@ -447,6 +614,9 @@ expand_perimeter (path_map_t *pmap, const view_map_t *vmap, const move_info_t *m
 	long new_loc;
 	int obj_cost;
 	int new_type;
+	const int *weight;
+
+	weight = weight_table (move_info);
 
 	for (i = 0; i < curp->len; i++) /* for each perimeter cell... */
 	FOR_ADJ_ON (curp->list[i], new_loc, j) {/* for each adjacent cell... */
@@ -465,7 +635,7 @@ expand_perimeter (path_map_t *pmap, const view_map_t *vmap, const move_info_t *m
 				pm->inc_cost = INFINITY/2;
 			}
 			if (pmap[new_loc].cost != INFINITY) { /* did we expand? */
-				obj_cost = objective_cost (vmap, move_info, new_loc, cur_cost);
+				obj_cost = objective_cost (vmap, weight, new_loc, cur_cost);
 				if (obj_cost < best_cost) {
 					best_cost = obj_cost;
 					best_loc = new_loc;
@@ -497,17 +667,15 @@ add_cell (path_map_t *pmap, long new_loc, perimeter_t *perim, int terrain, int c
 /* Compute the cost to move to an objective. */
 
 static int
-objective_cost (const view_map_t *vmap, const move_info_t *move_info, long loc, int base_cost)
+objective_cost (const view_map_t *vmap, const int *weight, long loc, int base_cost)
 {
-	char *p;
 	int w;
 	city_info_t *cityp;
 
-	p = strchr (move_info->objectives, vmap[loc].contents);
-	if (!p)
+	w = weight[vmap[loc].contents];
+	if (w == INFINITY)
 		return INFINITY;
 
-	w = move_info->weights[p - move_info->objectives];
 	if (w != W_TT_BUILD)
 	{
 		return w + base_cost;
@@ -530,6 +698,51 @@ objective_cost (const view_map_t *vmap, const move_info_t *move_info, long loc,
 	}
 }
 
+/*
+ * Return a table giving the weight of each kind of cell as an
+ * objective, or INFINITY if it is not one.  Looking for the cell in
+ * the list of objectives was taking much of the time of a search, so
+ * the first time each move_info is used we make its table, and we
+ * look it up once per pass rather than once per cell.  If we already
+ * have as many tables as we can keep, we make the table afresh in
+ * weight_scratch each time instead.
+ */
+
+#define NUM_MOVE_INFO 64	/* number of move_infos we keep tables for */
+
+static struct {
+	const move_info_t *move_info;
+	int weight[UCHAR_MAX+1];
+} weight_tab[NUM_MOVE_INFO];
+static int weight_count;
+static int weight_scratch[UCHAR_MAX+1];
+
+static const int *
+weight_table (const move_info_t *move_info)
+{
+	int i, n;
+	int *weight;
+
+	for (i = 0; i < weight_count; i++)
+		if (weight_tab[i].move_info == move_info)
+			return weight_tab[i].weight;
+
+	if (weight_count < NUM_MOVE_INFO) {
+		weight_tab[weight_count].move_info = move_info;
+		weight = weight_tab[weight_count++].weight;
+	}
+	else weight = weight_scratch; /* too many to keep */
+
+	for (n = 0; n <= UCHAR_MAX; n++)
+		weight[n] = INFINITY;
+
+	/* go backwards, so the first occurrence of an objective counts */
+	for (n = strlen (move_info->objectives) - 1; n >= 0; n--)
+		weight[(unsigned char)move_info->objectives[n]]
+			= move_info->weights[n];
+	return weight;
+}
+
 /* Return the type of terrain at a vmap location. */
 
 static int
@@ -595,14 +808,23 @@ terrain_type (const path_map_t *pmap, const view_map_t *vmap, const move_info_t
 void
 vmap_prune_explore_locs (view_map_t *vmap)
 {
-	path_map_t pmap[MAP_SIZE];
+	path_map_t *pmap;
+
+	pmap = pmap_get ();
+	prune_explore_locs (vmap, pmap);
+	pmap_put (pmap);
+}
+
+static void
+prune_explore_locs (view_map_t *vmap, path_map_t *pmap)
+{
 	perimeter_t *from, *to;
 	int explored;
 	long loc, new_loc;
 	long i;
 	long copied;
 
-	memset(pmap, 0, sizeof(pmap));
+	memset(pmap, 0, MAP_SIZE * sizeof(path_map_t));
 	from = &p1;
 	to = &p2;
 	from->len = 0;
@@ -763,14 +985,15 @@ vmap_find_dest (path_map_t path_map[], view_map_t vmap[], long cur_loc, long des
 	perimeter_t *to;
 	int cur_cost;
 	int start_terrain;
-	move_info_t move_info;
 	char old_contents;
+	static const move_info_t move_info[] = { /* indexed by owner */
+		{UNOWNED, "%", {1}},
+		{USER, "%", {1}},
+		{COMP, "%", {1}}
+	};
 
 	old_contents = vmap[dest_loc].contents;
 	vmap[dest_loc].contents = '%'; /* mark objective */
-	move_info.city_owner = owner;
-	move_info.objectives = "%";
-	move_info.weights[0] = 1;
 
 	from = &p1;
 	to = &p2;
@@ -783,7 +1006,7 @@ vmap_find_dest (path_map_t path_map[], view_map_t vmap[], long cur_loc, long des
 
 	for (;;) {
 		to->len = 0; /* nothing in perim yet */
-		expand_perimeter (path_map, vmap, &move_info, from,
+		expand_perimeter (path_map, vmap, &move_info[owner], from,
 				  terrain, cur_cost, 1, 1, to, to);
 		cur_cost += 1;
 		if (to->len == 0 || best_cost <= cur_cost) {
@@ -19,6 +19,11 @@
  * Other routines include:
  * 
  *     dist (a, b) -- returns the straight-line distance between two locations.
+ *
+ * Distances are looked up in a table, which 'dist_init' fills in at
+ * program startup.  If CHEBYSHEV_DIST is defined, the distance is
+ * instead the number of moves between the locations: the larger of
+ * the row and column differences.
  */
 
 #include <assert.h>
@@ -29,6 +34,7 @@
 #include "extern.h"
 
 long	dist (long, long);
+void	dist_init (void);
 long	rand_long (long);
 int	isqrt (int);
 void	rand_init (void);
@@ -49,22 +55,38 @@ rand_long (long high)
 }
 
 /*
- * Return the distance between two locations.
+ * Return the distance between two locations.  The distance depends
+ * only on the row and column differences, so it is computed once for
+ * each pair of differences by dist_init.
  */
 
 #define ABS(a) ((a) < 0 ? -(a) : (a))
 
+static short dist_tab[MAP_HEIGHT][MAP_WIDTH];
+
 long
 dist (long a, long b)
 {
-	long ax, ay, bx, by;
+	long drow, dcol;
 
-	ax = loc_row (a);
-	ay = loc_col (a);
-	bx = loc_row (b);
-	by = loc_col (b);
+	drow = loc_row (a) - loc_row (b);
+	dcol = loc_col (a) - loc_col (b);
+
+	return (dist_tab[ABS (drow)][ABS (dcol)]);
+}
+
+void
+dist_init (void)
+{
+	int drow, dcol;
 
-	return (isqrt(ABS (ax-bx) * (ABS (ax-bx)) + ( ABS (ay-by) * ABS (ay-by))));
+	for (drow = 0; drow < MAP_HEIGHT; drow++)
+	for (dcol = 0; dcol < MAP_WIDTH; dcol++)
+#ifdef CHEBYSHEV_DIST
+		dist_tab[drow][dcol] = drow > dcol ? drow : dcol;
+#else
+		dist_tab[drow][dcol] = isqrt (drow * drow + dcol * dcol);
+#endif
 }
 
 /*
@@ -0,0 +1,790 @@
+/*
+ *    Copyright (C) 1987, 1988 Chuck Simmons
+ *
+ * See the file COPYING, distributed with empire, for restriction
+ * and warranty information.
+ */
+
+/*
+ * movie.c -- record and replay movies of a game.
+ *
+ * After each side moves, we record a frame holding the character that
+ * would appear in each cell of the map if both sides could see
+ * everything.  Frames are written to 'empmovie.dat', which starts with
+ * a header:
+ *
+ *	magic		8 bytes, "EMPMOVIE" (no NUL)
+ *	version		16 bits, MOVIE_VERSION
+ *	map width	16 bits
+ *	map height	16 bits
+ *
+ * followed by the frames.  Each frame has a type, its frame number,
+ * and the length of the data which follows.  A key frame holds the
+ * whole map.  A delta frame holds the difference from the previous
+ * frame: the two frames are XORed together, and the result is written
+ * as a series of runs, each a count of unchanged cells followed by a
+ * count of cells and their XORed values.  Every MOVIE_KEY_INTERVAL
+ * frames we write a key frame, and we record its frame number and
+ * file offset in 'empmovie.idx', so that replay can start at any
+ * round without reading the whole movie.
+ *
+ * While recording, we also count the pieces in each frame and write
+ * the counts to 'empmovie.sta', so that the statistics of a game can
+ * be studied without decoding the map frames.  That file starts with
+ * a header:
+ *
+ *	magic		8 bytes, "EMPSTATS" (no NUL)
+ *	version		16 bits, STAT_VERSION
+ *	columns		16 bits, STAT_COLS
+ *
+ * followed by blocks of up to STAT_BLOCK frames.  Each block holds
+ * the number of its first frame (32 bits) and its number of frames
+ * (16 bits), then the values of each column for all of those frames
+ * in turn.  The columns are the number of each kind of piece on the
+ * board, in the order given by 'pieces' below, followed by the cost
+ * of building the user's and the computer's pieces.  Counts take 16
+ * bits and costs 32.  A block is written when it is full and when we
+ * stop recording; frames which are missing from the file have their
+ * statistics recomputed from the map during replay.
+ *
+ * All numbers are little-endian.  The movie file stays open while we
+ * are recording.  Movies written by older versions of empire, which
+ * are simply a compressed series of maps, can still be replayed.
+ */
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "empire.h"
+#include "extern.h"
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+typedef gzFile file;
+#define open_file(f, m) gzopen(f, m)
+#define close_file(f) gzclose(f)
+#define read_file(f, b, s) gzread(f, b, s)
+#else
+typedef FILE *file;
+#define open_file(x, y) fopen(x, y)
+#define close_file(x) fclose(x)
+#define read_file(f, b, s) fread(b, 1, s, f)
+#endif
+
+void	movie_close (void);
+int	movie_stats (void);
+void	replay_movie (void);
+void	save_movie_screen (void);
+static int	decode_frame (FILE *, long *);
+static long	encode_delta (void);
+static unsigned long	get_num (const unsigned char *, int);
+static void	make_frame (void);
+static int	movie_open (void);
+static int	movie_scan (FILE *, long *, long *);
+static void	put_num (unsigned char *, unsigned long, int);
+static void	replay_legacy (void);
+static void	stat_add (long, const long *);
+static void	stat_count (const char *, long *);
+static void	stat_display (const long *, int);
+static void	stat_flush (void);
+static int	stat_lookup (FILE *, long, long *);
+static FILE	*stat_open (int);
+static int	stat_read_block (FILE *);
+
+#define MOVIE_MAGIC "EMPMOVIE"
+#define MOVIE_VERSION 1
+#define MOVIE_HEADER (8 + 3 * 2)
+#define MOVIE_KEY_INTERVAL 64	/* frames between key frames */
+
+#define FRAME_KEY 'K'
+#define FRAME_DELTA 'D'
+#define FRAME_HEADER (1 + 4 + 4)
+#define INDEX_ENTRY (4 + 4)
+
+#define STAT_MAGIC "EMPSTATS"
+#define STAT_VERSION 1
+#define STAT_HEADER (8 + 2 * 2)
+#define STAT_BLOCK 64		/* frames per block of statistics */
+#define STAT_COUNTS (2*NUM_OBJECTS+2) /* columns holding piece counts */
+#define STAT_COLS (STAT_COUNTS+2) /* plus user and computer cost */
+#define STAT_USER_COST STAT_COUNTS
+#define STAT_COMP_COST (STAT_COUNTS+1)
+#define stat_bytes(col) ((col) < STAT_COUNTS ? 2 : 4)
+#define BLOCK_HEADER (4 + 2)
+
+static FILE *movie_file;	/* movie being recorded, if open */
+static long movie_frames;	/* frames in movie_file */
+static long since_key;		/* frames since last key frame, -1 if none */
+
+static char mapbuf[MAP_SIZE];	/* current frame */
+static char prevbuf[MAP_SIZE];	/* previous frame */
+static unsigned char codebuf[FRAME_HEADER + MAP_SIZE]; /* encoded frame */
+
+/* in declared order, with city first */
+static const char *pieces = "OAFPDSTCBZXafpdstcbz";
+
+static FILE *stat_file;		/* statistics being recorded, if open */
+static long stat_first;		/* first frame in stat_buf */
+static int stat_frames;		/* frames in stat_buf */
+static long stat_buf[STAT_COLS][STAT_BLOCK]; /* block being built or read */
+static unsigned char stat_code[BLOCK_HEADER + 4 * STAT_COLS * STAT_BLOCK];
+
+static void
+put_num (unsigned char *buf, unsigned long val, int bytes)
+{
+	int i;
+
+	for (i = 0; i < bytes; i++)
+		buf[i] = (val >> (8 * i)) & 0xff;
+}
+
+static unsigned long
+get_num (const unsigned char *buf, int bytes)
+{
+	unsigned long val;
+	int i;
+
+	val = 0;
+	for (i = bytes - 1; i >= 0; i--)
+		val = val << 8 | buf[i];
+	return (val);
+}
+
+/*
+ * Save a movie screen.  For each cell on the board, we write out
+ * the character that would appear on either the user's or the
+ * computer's screen.  This information is appended to 'empmovie.dat'.
+ */
+
+void
+save_movie_screen (void)
+{
+	long len;
+	unsigned char entry[INDEX_ENTRY];
+	FILE *idx;
+
+	if (movie_file == NULL && !movie_open ())
+		return;
+
+	make_frame ();
+
+	len = -1;
+	if (since_key >= 0 && since_key < MOVIE_KEY_INTERVAL - 1)
+		len = encode_delta ();
+
+	if (len >= 0) {
+		codebuf[0] = FRAME_DELTA;
+		since_key++;
+	}
+	else { /* key frame */
+		put_num (entry, movie_frames, 4);
+		put_num (entry + 4, ftell (movie_file), 4);
+		idx = fopen ("empmovie.idx", "ab");
+		if (idx != NULL) {
+			fwrite (entry, 1, INDEX_ENTRY, idx);
+			fclose (idx);
+		}
+		codebuf[0] = FRAME_KEY;
+		memcpy (codebuf + FRAME_HEADER, mapbuf, MAP_SIZE);
+		len = MAP_SIZE;
+		since_key = 0;
+	}
+	put_num (codebuf + 1, movie_frames, 4);
+	put_num (codebuf + 5, len, 4);
+
+	if (fwrite (codebuf, 1, FRAME_HEADER + len, movie_file) != (size_t)(FRAME_HEADER + len)
+	    || fflush (movie_file) != 0) {
+		error ("Cannot write empmovie.dat");
+		movie_close ();
+		return;
+	}
+	memcpy (prevbuf, mapbuf, MAP_SIZE);
+
+	if (stat_file != NULL) {
+		long row[STAT_COLS];
+
+		stat_count (mapbuf, row);
+		stat_add (movie_frames, row);
+	}
+	movie_frames++;
+}
+
+/* Fill in mapbuf with what is on the board right now. */
+
+static void
+make_frame (void)
+{
+	long i;
+	piece_info_t *p;
+
+	for (i = 0; i < MAP_SIZE; i++)
+	{
+		if (map[i].cityp)
+			mapbuf[i] = city_char[map[i].cityp->owner];
+		else
+		{
+			p = find_obj_at_loc (i);
+
+			if (!p)
+				mapbuf[i] = map[i].contents;
+			else if (p->owner == USER)
+				mapbuf[i] = piece_attr[p->type].sname;
+			else
+				mapbuf[i] = tolower(piece_attr[p->type].sname);
+		}
+	}
+}
+
+/*
+ * Encode the difference between prevbuf and mapbuf into codebuf.
+ * Return the length of the encoding, or -1 if it would be no smaller
+ * than a key frame.  Short runs of unchanged cells are folded into
+ * the changed run around them, since a new run costs four bytes.
+ */
+
+static long
+encode_delta (void)
+{
+	long i, j, len, same, diff;
+
+	len = 0;
+	for (i = 0; i < MAP_SIZE; ) {
+		for (same = 0; i + same < MAP_SIZE && same < 0xffff
+		    && mapbuf[i + same] == prevbuf[i + same]; same++)
+			;
+		i += same;
+
+		for (diff = 0; i + diff < MAP_SIZE && diff < 0xffff; diff++) {
+			if (mapbuf[i + diff] != prevbuf[i + diff])
+				continue;
+			for (j = 0; j < 4 && i + diff + j < MAP_SIZE
+			    && mapbuf[i + diff + j] == prevbuf[i + diff + j]; j++)
+				;
+			if (j == 4 || i + diff + j == MAP_SIZE)
+				break; /* worth starting a new run */
+		}
+		if (same == 0 && diff == 0)
+			break;
+
+		if (len + 4 + diff >= MAP_SIZE)
+			return (-1);
+		put_num (codebuf + FRAME_HEADER + len, same, 2);
+		put_num (codebuf + FRAME_HEADER + len + 2, diff, 2);
+		len += 4;
+		for (j = 0; j < diff; j++)
+			codebuf[FRAME_HEADER + len++] = mapbuf[i + j] ^ prevbuf[i + j];
+		i += diff;
+	}
+	return (len);
+}
+
+/*
+ * Open the movie file for recording.  If there is already a movie,
+ * we add to the end of it, dropping any partly written frame.  A movie
+ * in the old format is moved out of the way.
+ */
+
+static int
+movie_open (void)
+{
+	unsigned char header[MOVIE_HEADER];
+	long end;
+
+	movie_file = fopen ("empmovie.dat", "r+b");
+	if (movie_file != NULL) {
+		if (movie_scan (movie_file, &movie_frames, &end)
+		    && ftruncate (fileno (movie_file), end) == 0
+		    && fseek (movie_file, end, SEEK_SET) == 0) {
+			since_key = -1; /* start with a key frame */
+			stat_file = stat_open (TRUE);
+			return (TRUE);
+		}
+		fclose (movie_file);
+		if (rename ("empmovie.dat", "empmovie.old") == 0)
+			info ("Old movie moved to 'empmovie.old'.");
+	}
+
+	movie_file = fopen ("empmovie.dat", "w+b");
+	if (movie_file == NULL) {
+		error ("Cannot open empmovie.dat");
+		return (FALSE);
+	}
+	memcpy (header, MOVIE_MAGIC, 8);
+	put_num (header + 8, MOVIE_VERSION, 2);
+	put_num (header + 10, MAP_WIDTH, 2);
+	put_num (header + 12, MAP_HEIGHT, 2);
+	fwrite (header, 1, MOVIE_HEADER, movie_file);
+	(void) unlink ("empmovie.idx");
+	stat_file = stat_open (FALSE);
+
+	movie_frames = 0;
+	since_key = -1;
+	return (TRUE);
+}
+
+/* Stop recording. */
+
+void
+movie_close (void)
+{
+	if (movie_file != NULL)
+		fclose (movie_file);
+	movie_file = NULL;
+
+	stat_flush ();
+	if (stat_file != NULL)
+		fclose (stat_file);
+	stat_file = NULL;
+}
+
+/*
+ * Check the header of a movie and count its frames.  We return the
+ * number of complete frames and the offset just past the last one.
+ * Return FALSE if this is not a movie in our format.
+ */
+
+static int
+movie_scan (FILE *f, long *frames, long *end)
+{
+	unsigned char header[FRAME_HEADER];
+	unsigned char mheader[MOVIE_HEADER];
+	long len, size;
+
+	if (fseek (f, 0L, SEEK_END) != 0)
+		return (FALSE);
+	size = ftell (f);
+	rewind (f);
+
+	if (fread (mheader, 1, MOVIE_HEADER, f) != MOVIE_HEADER
+	    || memcmp (mheader, MOVIE_MAGIC, 8) != 0
+	    || get_num (mheader + 8, 2) != MOVIE_VERSION
+	    || get_num (mheader + 10, 2) != MAP_WIDTH
+	    || get_num (mheader + 12, 2) != MAP_HEIGHT)
+		return (FALSE);
+
+	*frames = 0;
+	*end = MOVIE_HEADER;
+	while (fread (header, 1, FRAME_HEADER, f) == FRAME_HEADER) {
+		len = get_num (header + 5, 4);
+		if ((header[0] != FRAME_KEY && header[0] != FRAME_DELTA)
+		    || get_num (header + 1, 4) != (unsigned long)*frames
+		    || len > MAP_SIZE || *end + FRAME_HEADER + len > size)
+			break;
+		fseek (f, len, SEEK_CUR);
+		*end += FRAME_HEADER + len;
+		*frames += 1;
+	}
+	return (TRUE);
+}
+
+/*
+ * Read the next frame of a movie and apply it to mapbuf.  Return FALSE
+ * at the end of the movie.  The frame's number is returned in 'frame'.
+ */
+
+static int
+decode_frame (FILE *f, long *frame)
+{
+	unsigned char header[FRAME_HEADER];
+	long len, pos, i, same, diff;
+
+	if (fread (header, 1, FRAME_HEADER, f) != FRAME_HEADER)
+		return (FALSE);
+	len = get_num (header + 5, 4);
+	if (len > MAP_SIZE || fread (codebuf, 1, len, f) != (size_t)len)
+		return (FALSE);
+	*frame = get_num (header + 1, 4);
+
+	if (header[0] == FRAME_KEY) {
+		if (len != MAP_SIZE) return (FALSE);
+		memcpy (mapbuf, codebuf, MAP_SIZE);
+		return (TRUE);
+	}
+	if (header[0] != FRAME_DELTA)
+		return (FALSE);
+
+	for (pos = 0, i = 0; pos + 4 <= len; ) {
+		same = get_num (codebuf + pos, 2);
+		diff = get_num (codebuf + pos + 2, 2);
+		pos += 4;
+		i += same;
+		if (i + diff > MAP_SIZE || pos + diff > len)
+			return (FALSE);
+		while (diff-- > 0)
+			mapbuf[i++] ^= codebuf[pos++];
+	}
+	return (TRUE);
+}
+
+/*
+ * Replay a movie.  We ask which round to start at, find the last key
+ * frame at or before that round in the index, and decode from there.
+ * Each frame is printed using a zoomed display.
+ */
+
+void
+replay_movie (void)
+{
+	FILE *f, *idx, *sf;
+	unsigned char entry[INDEX_ENTRY];
+	long frames, end, frame, first, offset;
+	long row[STAT_COLS];
+	int round;
+
+	f = fopen ("empmovie.dat", "rb"); /* open for input */
+	if (f == NULL)
+	{
+		error ("Cannot open empmovie.dat");
+		return;
+	}
+	if (!movie_scan (f, &frames, &end)) {
+		fclose (f);
+		replay_legacy ();
+		return;
+	}
+	if (frames == 0) {
+		fclose (f);
+		error ("The movie is empty.");
+		return;
+	}
+
+	round = get_int ("Start at round: ", 1, (frames + 1) / 2);
+	first = 2 * (round - 1); /* two frames per round */
+
+	/* find the closest preceding key frame */
+	offset = MOVIE_HEADER;
+	idx = fopen ("empmovie.idx", "rb");
+	if (idx != NULL) {
+		while (fread (entry, 1, INDEX_ENTRY, idx) == INDEX_ENTRY
+		    && (long)get_num (entry, 4) <= first)
+			offset = get_num (entry + 4, 4);
+		fclose (idx);
+	}
+	fseek (f, offset, SEEK_SET);
+
+	stat_flush (); /* so we can see the frames we are recording */
+	sf = fopen ("empmovie.sta", "rb");
+	if (sf != NULL && stat_read_block (sf) < 0) {
+		fclose (sf);
+		sf = NULL;
+	}
+	stat_frames = 0; /* nothing read yet */
+
+	term_clear();
+
+	while (decode_frame (f, &frame))
+	{
+		if (frame < first) continue; /* not there yet */
+
+		if (sf == NULL || !stat_lookup (sf, frame, row))
+			stat_count (mapbuf, row);
+		stat_display (row, frame + 1);
+		print_movie_screen (mapbuf);
+	}
+
+	if (sf != NULL)
+		fclose (sf);
+	stat_frames = 0; /* leave stat_buf empty for recording */
+	fclose (f);
+}
+
+/*
+ * Replay a movie written by an older version of empire.  We read each
+ * buffer from the file and print it using a zoomed display.
+ */
+
+static void
+replay_legacy (void)
+{
+	file f; /* file to read movie from */
+	long row[STAT_COLS];
+	int round;
+
+	f = open_file("empmovie.dat", "r"); /* open for input */
+	if (f == NULL)
+	{
+		error ("Cannot open empmovie.dat");
+		return;
+	}
+	round = 0;
+
+	term_clear();
+
+	while (1)
+	{
+		if (read_file (f, mapbuf, sizeof(mapbuf)) != sizeof(mapbuf))
+			break;
+
+		round += 1;
+
+		stat_count(mapbuf, row);
+		stat_display(row, round);
+
+		print_movie_screen(mapbuf);
+	}
+
+	close_file(f);
+}
+
+/*
+ * Open 'empmovie.sta' for recording.  If 'append' is set and there is
+ * a statistics file in our format, we add to the end of it, dropping
+ * any partly written block.  Otherwise we start a new one.  We return
+ * NULL if the statistics cannot be recorded; the movie is recorded
+ * anyway.
+ */
+
+static FILE *
+stat_open (int append)
+{
+	unsigned char header[STAT_HEADER];
+	FILE *f;
+	long end;
+	int n;
+
+	stat_frames = 0;
+
+	if (append && (f = fopen ("empmovie.sta", "r+b")) != NULL) {
+		n = stat_read_block (f);
+		end = STAT_HEADER;
+		while (n > 0) {
+			end = ftell (f);
+			n = stat_read_block (f);
+		}
+		stat_frames = 0;
+		if (n == 0 && ftruncate (fileno (f), end) == 0
+		    && fseek (f, end, SEEK_SET) == 0)
+			return (f);
+		fclose (f);
+	}
+
+	f = fopen ("empmovie.sta", "w+b");
+	if (f == NULL) {
+		error ("Cannot open empmovie.sta");
+		return (NULL);
+	}
+	memcpy (header, STAT_MAGIC, 8);
+	put_num (header + 8, STAT_VERSION, 2);
+	put_num (header + 10, STAT_COLS, 2);
+	if (fwrite (header, 1, STAT_HEADER, f) != STAT_HEADER) {
+		fclose (f);
+		return (NULL);
+	}
+	return (f);
+}
+
+/* Add a frame's statistics to the block being built. */
+
+static void
+stat_add (long frame, const long *row)
+{
+	int c;
+
+	if (stat_frames == 0)
+		stat_first = frame;
+	for (c = 0; c < STAT_COLS; c++)
+		stat_buf[c][stat_frames] = row[c];
+	if (++stat_frames == STAT_BLOCK)
+		stat_flush ();
+}
+
+/* Write out the block being built, if any. */
+
+static void
+stat_flush (void)
+{
+	long len;
+	int c, i;
+
+	if (stat_file == NULL || stat_frames == 0)
+		return;
+
+	put_num (stat_code, stat_first, 4);
+	put_num (stat_code + 4, stat_frames, 2);
+	len = BLOCK_HEADER;
+	for (c = 0; c < STAT_COLS; c++)
+		for (i = 0; i < stat_frames; i++) {
+			put_num (stat_code + len, stat_buf[c][i], stat_bytes (c));
+			len += stat_bytes (c);
+		}
+	stat_frames = 0;
+
+	if (fwrite (stat_code, 1, len, stat_file) != (size_t)len
+	    || fflush (stat_file) != 0) {
+		error ("Cannot write empmovie.sta");
+		fclose (stat_file);
+		stat_file = NULL;
+	}
+}
+
+/*
+ * Read the next item from a statistics file into stat_buf.  At the
+ * start of the file this is the header; afterwards it is a block.
+ * Return the number of frames read (1 for the header), 0 at the end
+ * of the file, or -1 if the file is not in our format.
+ */
+
+static int
+stat_read_block (FILE *f)
+{
+	long len, pos;
+	int c, i, n;
+
+	if (ftell (f) == 0) {
+		if (fread (stat_code, 1, STAT_HEADER, f) != STAT_HEADER
+		    || memcmp (stat_code, STAT_MAGIC, 8) != 0
+		    || get_num (stat_code + 8, 2) != STAT_VERSION
+		    || get_num (stat_code + 10, 2) != STAT_COLS)
+			return (-1);
+		return (1);
+	}
+
+	if (fread (stat_code, 1, BLOCK_HEADER, f) != BLOCK_HEADER)
+		return (0);
+	n = get_num (stat_code + 4, 2);
+	if (n == 0 || n > STAT_BLOCK)
+		return (0);
+	len = n * (2 * STAT_COUNTS + 4 * (STAT_COLS - STAT_COUNTS));
+	if (fread (stat_code + BLOCK_HEADER, 1, len, f) != (size_t)len)
+		return (0);
+
+	stat_first = get_num (stat_code, 4);
+	stat_frames = n;
+	pos = BLOCK_HEADER;
+	for (c = 0; c < STAT_COLS; c++)
+		for (i = 0; i < n; i++) {
+			stat_buf[c][i] = get_num (stat_code + pos, stat_bytes (c));
+			pos += stat_bytes (c);
+		}
+	return (n);
+}
+
+/*
+ * Find the statistics for a frame, reading forward through the file
+ * as necessary.  Return FALSE if the frame was not recorded.
+ */
+
+static int
+stat_lookup (FILE *f, long frame, long *row)
+{
+	int c;
+
+	while (stat_frames == 0 || frame >= stat_first + stat_frames) {
+		if (stat_read_block (f) <= 0) {
+			stat_frames = 0;
+			return (FALSE);
+		}
+	}
+	if (frame < stat_first)
+		return (FALSE);
+
+	for (c = 0; c < STAT_COLS; c++)
+		row[c] = stat_buf[c][frame - stat_first];
+	return (TRUE);
+}
+
+/*
+ * Count the pieces in a frame, and work out what they cost to build.
+ * There may be objects in cities and boats that aren't counted.
+ */
+
+static void
+stat_count (const char *mbuf, long *row)
+{
+	static signed char column[UCHAR_MAX+1];
+	static int init = FALSE;
+	long i;
+	int c;
+
+	if (!init) { /* map each character to its column */
+		memset (column, -1, sizeof (column));
+		for (c = 0; pieces[c]; c++)
+			column[(unsigned char)pieces[c]] = c;
+		init = TRUE;
+	}
+
+	memset (row, 0, STAT_COLS * sizeof (*row));
+
+	for (i = 0; i < MAP_SIZE; i++)
+	{
+		c = column[(unsigned char)mbuf[i]];
+		if (c >= 0) row[c] += 1;
+	}
+
+	for (i = 1; i <= NUM_OBJECTS; i++)
+		row[STAT_USER_COST] += row[i] * piece_attr[i-1].build_time;
+
+	for (i = NUM_OBJECTS+2; i <= 2*NUM_OBJECTS+1; i++)
+		row[STAT_COMP_COST] += row[i] * piece_attr[i-NUM_OBJECTS-2].build_time;
+}
+
+/*
+ * Print the statistics recorded with a movie, one line per frame,
+ * so that they can be studied with other tools.  Return FALSE if
+ * there are no statistics.
+ */
+
+int
+movie_stats (void)
+{
+	FILE *f;
+	int c, i;
+
+	f = fopen ("empmovie.sta", "rb");
+	if (f == NULL || stat_read_block (f) < 0) {
+		if (f != NULL) fclose (f);
+		return (FALSE);
+	}
+
+	printf ("frame round");
+	for (c = 0; pieces[c]; c++)
+		printf (" %c", pieces[c]);
+	printf (" user_cost comp_cost\n");
+
+	while (stat_read_block (f) > 0) {
+		for (i = 0; i < stat_frames; i++) {
+			printf ("%ld %ld", stat_first + i,
+				 (stat_first + i) / 2 + 1);
+			for (c = 0; c < STAT_COLS; c++)
+				printf (" %ld", stat_buf[c][i]);
+			printf ("\n");
+		}
+	}
+	stat_frames = 0;
+	fclose (f);
+	return (TRUE);
+}
+
+/*
+ * Display statistics about the game.  At the top of the screen we
+ * print:
+ *
+ * nn O  nn A  nn F  nn P  nn D  nn S  nn T  nn C  nn B  nn Z  xxxxx
+ * nn X  nn a  nn f  nn p  nn d  nn s  nn t  nn c  nn b  nn z  xxxxx
+ *
+ * The "xxxxx" field is the cumulative cost of building the hardware.
+ */
+
+static void
+stat_display (const long *row, int round)
+{
+	long i;
+	char buf1[STRSIZE], buf2[STRSIZE];
+
+	for (i = FIRST_OBJECT; i < NUM_OBJECTS+1; i++)
+	{
+		snprintf(buf1 + (i*6), STRSIZE - (i*6), "%2ld %c  ", row[i], pieces[i]);
+		snprintf(buf2 + (i*6), STRSIZE - (i*6), "%2ld %c  ", row[i+NUM_OBJECTS+1], pieces[i+NUM_OBJECTS+1]);
+	}
+
+	snprintf(buf1 + (i*6), STRSIZE - (i*6), "%5ld", row[STAT_USER_COST]);
+	snprintf(buf2 + (i*6), STRSIZE - (i*6), "%5ld", row[STAT_COMP_COST]);
+
+	info(buf1);
+	info(buf2);
+	info("");
+
+	prompt("Round %3d", (round + 1) / 2);
+}
@@ -35,38 +35,76 @@ int     obj_capacity (const piece_info_t *);
 int     obj_moves (const piece_info_t *);
 void    produce (city_info_t *);
 void    scan (view_map_t[], long);
+void    scan_side (int);
 void    set_prod (city_info_t *);
 static long	bounce (long, long, long, long);
 static void	kill_one (piece_info_t **, piece_info_t *);
 static void	move_sat1 (piece_info_t *obj);
+static void	near_build (int);
 static void	scan_sat (view_map_t *, long);
 static void	update (view_map_t[], long);
+static int	update_cell (view_map_t[], long);
 
 /*
  * Find the nearest city to a location.  Return the location
  * of the city and the estimated cost to reach the city.
  * Distances are computed as straight-line distances.
+ *
+ * Fighters ask this on every move, so for each owner we keep the
+ * answer for every location on the map.  It is worked out when first
+ * needed after any city changes hands; city_changed must be called
+ * whenever that happens.
  */
 
+static int near_dist[COMP+1][MAP_SIZE];	/* distance to nearest city */
+static long near_loc[COMP+1][MAP_SIZE];	/* location of nearest city */
+static char near_valid[COMP+1];		/* TRUE if the above are good */
+
 int
 find_nearest_city (long loc, int owner, long *city_loc)
+{
+	if (!near_valid[owner])
+		near_build (owner);
+
+	*city_loc = near_loc[owner][loc];
+	return near_dist[owner][loc];
+}
+
+/* Note that a city has changed hands. */
+
+void
+city_changed (void)
+{
+	memset (near_valid, 0, sizeof (near_valid));
+}
+
+/*
+ * Find the nearest city of an owner to each location.  Ties go to
+ * the city which comes first in the city table.
+ */
+
+static void
+near_build (int owner)
 {
 	long best_dist, best_loc;
-	long new_dist, i;
+	long new_dist, i, loc;
 	
-	best_dist = INFINITY;
-	best_loc = loc;
+	for (loc = 0; loc < MAP_SIZE; loc++) {
+		best_dist = INFINITY;
+		best_loc = loc;
 	
-	for (i = 0; i < NUM_CITY; i++) 
-	if (city[i].owner == owner) {
-	       new_dist = dist (loc, city[i].loc);
-	       if (new_dist < best_dist) {
-		       best_dist = new_dist;
-		       best_loc = city[i].loc;
-	       }
+		for (i = 0; i < NUM_CITY; i++) 
+		if (city[i].owner == owner) {
+		       new_dist = dist (loc, city[i].loc);
+		       if (new_dist < best_dist) {
+			       best_dist = new_dist;
+			       best_loc = city[i].loc;
+		       }
+		}
+		near_dist[owner][loc] = best_dist;
+		near_loc[owner][loc] = best_loc;
 	}
-	*city_loc = best_loc;
-	return best_dist;
+	near_valid[owner] = TRUE;
 }
 
 /* Given the location of a city, return the index of that city. */
@@ -263,6 +301,8 @@ kill_city (city_info_t *cityp)
 			p->owner = (p->owner == USER ? COMP : USER);
 			list = LIST (p->owner);
 			LINK (list[p->type], p, piece_link);
+			if (p->owner == USER)
+				user_sector_changed (loc_sector (p->loc));
 			
 			p->func = NOFUNC;
 		}
@@ -271,6 +311,7 @@ kill_city (city_info_t *cityp)
 	if (cityp->owner != UNOWNED) {
 		vmap = MAP(cityp->owner);
 		cityp->owner = UNOWNED;
+		city_changed ();
 		cityp->work = 0;
 		cityp->prod = NOPIECE;
 		
@@ -353,6 +394,9 @@ move_obj (piece_info_t *obj, long new_loc)
 		UNLINK (map[old_loc].objp, p, loc_link);
 		LINK (map[new_loc].objp, p, loc_link);
 	}
+
+	if (obj->owner == USER && loc_sector (old_loc) != loc_sector (new_loc))
+		user_sector_changed (loc_sector (new_loc));
 	
 	switch (obj->type)
 	{
@@ -560,6 +604,75 @@ scan (view_map_t vmap[], long loc)
 	update (vmap, loc); /* update current location as well */
 }
 
+/*
+ * Scan around every piece and city belonging to one side at the start
+ * of a turn.  Pieces stacked in cities or aboard ships would otherwise
+ * rescan the same cells over and over, so we first mark every cell
+ * covered by some observer in a bitmap, then update each marked cell
+ * exactly once.  Only cells whose contents actually changed are
+ * redisplayed.
+ */
+
+static unsigned char scan_bits[(MAP_SIZE + 7) / 8];
+static long scan_list[MAP_SIZE];
+
+#define SCAN_MARKED(loc) (scan_bits[(loc) >> 3] & (1 << ((loc) & 7)))
+#define SCAN_MARK(loc) (scan_bits[(loc) >> 3] |= (1 << ((loc) & 7)))
+
+static int
+scan_mark (int count, long loc)
+{
+	int i;
+	long xloc;
+
+	assert (map[loc].on_board); /* observer must be on board */
+
+	for (i = 0; i < 9; i++) { /* current location and surrounding cells */
+		xloc = (i == 8) ? loc : loc + dir_offset[i];
+		if (!SCAN_MARKED (xloc)) {
+			SCAN_MARK (xloc);
+			scan_list[count++] = xloc;
+		}
+	}
+	return (count);
+}
+
+void
+scan_side (int owner)
+{
+	view_map_t *vmap;
+	piece_info_t **list;
+	piece_info_t *obj;
+	piece_type_t n;
+	int i, count;
+
+#ifdef DEBUG
+	check (); /* perform a consistency check */
+#endif
+	if (owner == USER) {
+		vmap = user_map;
+		list = user_obj;
+	}
+	else {
+		vmap = comp_map;
+		list = comp_obj;
+	}
+	memset (scan_bits, 0, sizeof (scan_bits));
+	count = 0;
+
+	for (n = FIRST_OBJECT; n < NUM_OBJECTS; n++)
+		for (obj = list[n]; obj != NULL; obj = obj->piece_link.next)
+			count = scan_mark (count, obj->loc);
+
+	for (i = 0; i < NUM_CITY; i++)
+		if (city[i].owner == owner)
+			count = scan_mark (count, city[i].loc);
+
+	for (i = 0; i < count; i++)
+		if (update_cell (vmap, scan_list[i]))
+			display_locx (owner, vmap, scan_list[i]);
+}
+
 /* Scan a portion of the board for a satellite. */
 
 static void
@@ -586,10 +699,31 @@ scan_sat (view_map_t *vmap, long loc)
 
 static void
 update (view_map_t vmap[], long loc)
+{
+	(void) update_cell (vmap, loc);
+
+	if (vmap == comp_map)
+		display_locx (COMP, comp_map, loc);
+	else if (vmap == user_map)
+		display_locx (USER, user_map, loc);
+}
+
+/*
+ * Update a location without displaying it.  Return TRUE if the
+ * contents of the cell changed.
+ */
+
+static int
+update_cell (view_map_t vmap[], long loc)
 {
 	piece_info_t *p;
+	unsigned char old;
 
-	vmap[loc].seen = date;
+	old = vmap[loc].contents;
+	if (vmap == comp_map)
+		comp_seen[loc] = date;
+	else if (vmap == user_map)
+		user_seen[loc] = date;
 	
 	if (map[loc].cityp) /* is there a city here? */
 		vmap[loc].contents = city_char[map[loc].cityp->owner];
@@ -603,10 +737,11 @@ update (view_map_t vmap[], long loc)
 			vmap[loc].contents = piece_attr[p->type].sname;
 		else vmap[loc].contents = tolower (piece_attr[p->type].sname);
 	}
+	if (vmap[loc].contents == old)
+		return (FALSE);
 	if (vmap == comp_map)
-		display_locx (COMP, comp_map, loc);
-	else if (vmap == user_map)
-		display_locx (USER, user_map, loc);
+		comp_map_changed (loc); /* keep the computer's maps up to date */
+	return (TRUE);
 }
 
 /*
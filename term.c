@@ -70,6 +70,7 @@ prompt (char *buf, ...)
 {
 	va_list ap;
 
+	display_flush (); /* bring the map up to date first */
 	va_start(ap, buf);
 
 	wmove(statuswin, 0, 0);
@@ -153,6 +154,8 @@ get_chx (void)
 {
         char c;
 
+	display_hold (FALSE); /* map must be current while we wait */
+	display_flush ();
 	crmode();
         c = wgetch(statuswin);
         nocrmode();
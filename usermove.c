@@ -47,17 +47,36 @@ void	user_fill (piece_info_t *);
 void	user_land (piece_info_t *);
 void	user_random (piece_info_t *);
 void	user_repair (piece_info_t *);
+void	user_sector_changed (int);
 void	user_set_city_func (piece_info_t *);
 void	user_set_dir (piece_info_t *);
 void	user_sentry (piece_info_t *);
 void	user_skip (piece_info_t *);
 void	user_transport (piece_info_t *);
 void	user_wake (piece_info_t *);
+static void	bucket_pieces (void);
+
+/*
+ * To move the pieces in each sector without walking every piece for
+ * every sector, we sort the user's pieces by sector once per turn.
+ * sector_list holds the pieces of each sector in turn, and within a
+ * sector, the pieces of each type in move_order, in list order.  The
+ * pieces of type move_order[n] in sector s are sector_list[i] for
+ * sector_start[s][n] <= i < sector_start[s][n+1].
+ *
+ * If a piece moves into a sector, or becomes the user's, we no longer
+ * know where it belongs in that sector's part of the list, so we mark
+ * the sector mixed and move its pieces by walking the lists instead.
+ */
+
+static piece_info_t *sector_list[LIST_SIZE];
+static int sector_start[NUM_SECTORS][NUM_OBJECTS+1];
+static char sector_mixed[NUM_SECTORS];
 
 void
 user_move (void)
 {
-	int i, sec, sec_start;
+	int i, j, sec, sec_start;
 	piece_type_t n;
 	piece_info_t *obj, *next_obj;
 	int prod;
@@ -73,15 +92,13 @@ user_move (void)
 
 	for (n = FIRST_OBJECT; n < NUM_OBJECTS; n++)
 		for (obj = user_obj[n]; obj != NULL; obj = obj->piece_link.next)
-		{
 			obj->moved = 0; /* nothing moved yet */
-			scan (user_map, obj->loc); /* refresh user's view of world */
-		}
+
+	scan_side (USER); /* refresh user's view of world */
 
 	/* produce new hardware */
 	for (i = 0; i < NUM_CITY; i++)
 	    if (city[i].owner == USER) {
-		scan (user_map, city[i].loc);
 		prod = city[i].prod;
 
 		if (prod == NOPIECE)
@@ -106,6 +123,8 @@ user_move (void)
 	sec_start = cur_sector (); /* get currently displayed sector */
 	if (sec_start == -1) sec_start = 0;
 
+	bucket_pieces (); /* sort pieces by sector */
+
 	/* loop through sectors, moving every piece in the sector */
 	for (i = sec_start; i < sec_start + NUM_SECTORS; i++)
 	{
@@ -113,6 +132,7 @@ user_move (void)
 		sector_change (); /* allow screen to be redrawn */
 
 		for (n = FIRST_OBJECT; n < NUM_OBJECTS; n++) /* loop through obj lists */
+		if (sector_mixed[sec]) {
 			for (obj = user_obj[move_order[n]]; obj != NULL; obj = next_obj)
 			{
 				/* loop through objs in list */
@@ -122,16 +142,72 @@ user_move (void)
 					if (loc_sector (obj->loc) == sec) /* object in sector? */
 						piece_move (obj); /* yup; move the object */
 			}
+		}
+		else {
+			for (j = sector_start[sec][n]; j < sector_start[sec][n+1]; j++)
+			{
+				obj = sector_list[j];
+
+				/* skip dead, captured, and departed objects */
+				if (!obj->moved && obj->owner == USER
+				    && loc_sector (obj->loc) == sec)
+					piece_move (obj);
+			}
+		}
                 
                 if (cur_sector() == sec)
                 {
                         /* is sector displayed? */
 			print_sector_u (sec); /* make screen up-to-date */
 		}
+		else display_flush (); /* show what happened in this sector */
 	}
 	if (save_movie) save_movie_screen ();
 }
 
+/* Sort the user's pieces by sector, as described above. */
+
+static void
+bucket_pieces (void)
+{
+	int sec, n, total;
+	int next[NUM_SECTORS][NUM_OBJECTS];
+	piece_info_t *obj;
+
+	memset (next, 0, sizeof (next));
+	memset (sector_mixed, 0, sizeof (sector_mixed));
+
+	/* count the pieces of each type in each sector */
+	for (n = FIRST_OBJECT; n < NUM_OBJECTS; n++)
+		for (obj = user_obj[move_order[n]]; obj != NULL; obj = obj->piece_link.next)
+			next[loc_sector (obj->loc)][n] += 1;
+
+	/* turn the counts into starting positions */
+	total = 0;
+	for (sec = 0; sec < NUM_SECTORS; sec++)
+		for (n = FIRST_OBJECT; n < NUM_OBJECTS; n++) {
+			sector_start[sec][n] = total;
+			total += next[sec][n];
+			next[sec][n] = sector_start[sec][n];
+		}
+	for (sec = 0; sec < NUM_SECTORS; sec++)
+		sector_start[sec][NUM_OBJECTS] = (sec + 1 < NUM_SECTORS ?
+					sector_start[sec+1][FIRST_OBJECT] : total);
+
+	/* and put each piece in its place */
+	for (n = FIRST_OBJECT; n < NUM_OBJECTS; n++)
+		for (obj = user_obj[move_order[n]]; obj != NULL; obj = obj->piece_link.next)
+			sector_list[next[loc_sector (obj->loc)][n]++] = obj;
+}
+
+/* Note that a piece has moved into a sector, or become the user's. */
+
+void
+user_sector_changed (int sec)
+{
+	sector_mixed[sec] = TRUE;
+}
+
 /*
  * Move a piece.  We loop until all the moves of a piece are made.  Within
  * the loop, we first awaken the piece if it is adjacent to an enemy piece.
@@ -229,6 +305,8 @@ piece_move (piece_info_t *obj)
 		&& obj->hits < max_hits /* it is damaged? */
 		&& user_map[obj->loc].contents == 'O') /* it is in port? */
 	obj->hits++; /* fix some damage */
+
+	display_flush (); /* let user see the completed move */
 }
 
 /*
@@ -267,10 +345,11 @@ move_random (piece_info_t *obj)
 void
 move_explore (piece_info_t *obj)
 {
-	path_map_t path_map[MAP_SIZE];
+	path_map_t *path_map;
 	long loc;
 	const char *terrain;
 
+	path_map = pmap_get ();
 	switch (obj->type) {
 	case ARMY:
 		loc = vmap_find_lobj (path_map, user_map, obj->loc, &user_army);
@@ -286,13 +365,17 @@ move_explore (piece_info_t *obj)
 		break;
 	}
 
-	if (loc == obj->loc) return; /* nothing to explore */
+	if (loc == obj->loc) { /* nothing to explore */
+		pmap_put (path_map);
+		return;
+	}
 
 	if (user_map[loc].contents == ' ' && path_map[loc].cost == 2)
 		vmap_mark_adjacent (path_map, obj->loc);
 	else vmap_mark_path (path_map, user_map, loc);
 
 	loc = vmap_find_dir (path_map, user_map, obj->loc, terrain, " ");
+	pmap_put (path_map);
 	if (loc != obj->loc) move_obj (obj, loc);
 }
 
@@ -359,18 +442,23 @@ move_armyload (piece_info_t *obj)
 void
 move_armyattack (piece_info_t *obj)
 {
-	path_map_t path_map[MAP_SIZE];
+	path_map_t *path_map;
 	long loc;
 
 	assert (obj->type == ARMY);
 
+	path_map = pmap_get ();
 	loc = vmap_find_lobj (path_map, user_map, obj->loc, &user_army_attack);
 
-	if (loc == obj->loc) return; /* nothing to attack */
+	if (loc == obj->loc) { /* nothing to attack */
+		pmap_put (path_map);
+		return;
+	}
 
 	vmap_mark_path (path_map, user_map, loc);
 
 	loc = vmap_find_dir (path_map, user_map, obj->loc, "+", "X*a");
+	pmap_put (path_map);
 	if (loc != obj->loc) move_obj (obj, loc);
 }
 
@@ -385,7 +473,7 @@ move_ttload (piece_info_t *obj)
 void
 move_repair (piece_info_t *obj)
 {
-	path_map_t path_map[MAP_SIZE];
+	path_map_t *path_map;
 	long loc;
 
 	assert (obj->type > FIGHTER);
@@ -400,14 +488,19 @@ move_repair (piece_info_t *obj)
 		return;
 	}
 
+	path_map = pmap_get ();
 	loc = vmap_find_wobj (path_map, user_map, obj->loc, &user_ship_repair);
 
-	if (loc == obj->loc) return; /* no reachable city */
+	if (loc == obj->loc) { /* no reachable city */
+		pmap_put (path_map);
+		return;
+	}
 
 	vmap_mark_path (path_map, user_map, loc);
 
 	/* try to be next to ocean to avoid enemy pieces */
 	loc = vmap_find_dir (path_map, user_map, obj->loc, ".O", ".");
+	pmap_put (path_map);
 	if (loc != obj->loc) move_obj (obj, loc);
 }
 
@@ -500,7 +593,7 @@ move_path (piece_info_t *obj)
 void
 move_to_dest (piece_info_t *obj, long dest)
 {
-	path_map_t path_map[MAP_SIZE];
+	path_map_t *path_map;
 	int fterrain;
 	const char *mterrain;
 	long new_loc;
@@ -520,12 +613,17 @@ move_to_dest (piece_info_t *obj, long dest)
 		break;
 	}
 
+	path_map = pmap_get ();
 	new_loc = vmap_find_dest (path_map, user_map, obj->loc, dest,
 				  USER, fterrain);
-	if (new_loc == obj->loc) return; /* can't get there */
+	if (new_loc == obj->loc) { /* can't get there */
+		pmap_put (path_map);
+		return;
+	}
 
 	vmap_mark_path (path_map, user_map, dest);
 	new_loc = vmap_find_dir (path_map, user_map, obj->loc, mterrain, " .");
+	pmap_put (path_map);
 	if (new_loc == obj->loc) return; /* can't move ahead */
 	assert (good_loc (obj, new_loc));
 	move_obj (obj, new_loc); /* everything looks good */
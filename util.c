@@ -12,11 +12,14 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include "empire.h"
 #include "extern.h"
 
 void	check (void);
+long	clock_ms (void);
 void	emp_panic (const char *, const int, const char *);
 static void	check_cargo (const piece_info_t *, const piece_type_t);
 static void	check_obj (piece_info_t **, const int);
@@ -58,12 +61,10 @@ check (void)
 	piece_info_t *p;
 	
 	/* nothing in any list yet */
-	for (i = 0; i < LIST_SIZE; i++) {
-		in_free[i] = 0;
-		in_obj[i] = 0;
-		in_loc[i] = 0;
-		in_cargo[i] = 0;
-	}
+	memset (in_free, 0, sizeof (in_free));
+	memset (in_obj, 0, sizeof (in_obj));
+	memset (in_loc, 0, sizeof (in_loc));
+	memset (in_cargo, 0, sizeof (in_cargo));
 		
 	/* Mark all objects in free list.  Make sure objects in free list
 	have zero hits. */
@@ -241,3 +242,18 @@ emp_panic (const char *file, const int line, const char *why)
 	
 	abort();
 }
+
+/*
+ * Return a millisecond count from a clock which is unaffected by
+ * changes to the time of day.  Only differences between values are
+ * meaningful.
+ */
+
+long
+clock_ms (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ((long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}